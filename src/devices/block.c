@@ -4,6 +4,7 @@
 #include <stdio.h>
 #include "devices/ide.h"
 #include "threads/malloc.h"
+#include "threads/trace.h"
 
 /* A block device. */
 struct block
@@ -121,7 +122,9 @@ void
 block_read (struct block *block, block_sector_t sector, void *buffer)
 {
   check_sector (block, sector);
+  trace_event (TRACE_BLOCK_START, sector, block->type << 1);
   block->ops->read (block->aux, sector, buffer);
+  trace_event (TRACE_BLOCK_DONE, sector, block->type << 1);
   block->read_cnt++;
 }
 
@@ -135,7 +138,9 @@ block_write (struct block *block, block_sector_t sector, const void *buffer)
 {
   check_sector (block, sector);
   ASSERT (block->type != BLOCK_FOREIGN);
+  trace_event (TRACE_BLOCK_START, sector, block->type << 1 | 1);
   block->ops->write (block->aux, sector, buffer);
+  trace_event (TRACE_BLOCK_DONE, sector, block->type << 1 | 1);
   block->write_cnt++;
 }
 
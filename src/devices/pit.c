@@ -11,9 +11,6 @@
 #define PIT_PORT_CONTROL          0x43                /* Control port. */
 #define PIT_PORT_COUNTER(CHANNEL) (0x40 + (CHANNEL))  /* Counter port. */
 
-/* PIT cycles per second. */
-#define PIT_HZ 1193180
-
 /* Configure the given CHANNEL in the PIT.  In a PC, the PIT's
    three output channels are hooked up like this:
 
@@ -81,3 +78,52 @@ pit_configure_channel (int channel, int mode, int frequency)
   outb (PIT_PORT_COUNTER (channel), count >> 8);
   intr_set_level (old_level);
 }
+
+/* Makes channel 0 count down COUNT cycles, which must be
+   nonzero, once, in mode 0, so that it raises a single timer
+   interrupt when it reaches 0.  pit_configure_channel() puts
+   it back into periodic mode. */
+void
+pit_oneshot (uint16_t count)
+{
+  enum intr_level old_level;
+
+  ASSERT (count != 0);
+
+  old_level = intr_disable ();
+  outb (PIT_PORT_CONTROL, 0x30);
+  outb (PIT_PORT_COUNTER (0), count);
+  outb (PIT_PORT_COUNTER (0), count >> 8);
+  intr_set_level (old_level);
+}
+
+/* Returns the current count of channel 0.  If EXPIRED is
+   nonnull, also stores in it whether the channel's output is
+   high, which in mode 0 means the countdown has reached 0 and
+   the count has wrapped around. */
+uint16_t
+pit_read_count (bool *expired)
+{
+  enum intr_level old_level;
+  uint8_t status = 0, lo, hi;
+
+  old_level = intr_disable ();
+  if (expired != NULL)
+    {
+      /* Read-back command: latch status and count of channel 0. */
+      outb (PIT_PORT_CONTROL, 0xc2);
+      status = inb (PIT_PORT_COUNTER (0));
+    }
+  else
+    {
+      /* Counter latch command for channel 0. */
+      outb (PIT_PORT_CONTROL, 0x00);
+    }
+  lo = inb (PIT_PORT_COUNTER (0));
+  hi = inb (PIT_PORT_COUNTER (0));
+  intr_set_level (old_level);
+
+  if (expired != NULL)
+    *expired = (status & 0x80) != 0;
+  return lo | hi << 8;
+}
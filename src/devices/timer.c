@@ -3,8 +3,11 @@
 #include <inttypes.h>
 #include <round.h>
 #include <stdio.h>
+#include <string.h>
 #include "devices/pit.h"
 #include "threads/interrupt.h"
+#include "threads/io.h"
+#include "threads/malloc.h"
 #include "threads/synch.h"
 #include "threads/thread.h"
   
@@ -24,6 +27,43 @@ static int64_t ticks;
    Initialized by timer_calibrate(). */
 static unsigned loops_per_tick;
 
+/**pj3*****************************************************/
+/* PIT cycles per timer tick, rounded as pit_configure_channel()
+   does. */
+#define TICK_CYCLES ((PIT_HZ + TIMER_FREQ / 2) / TIMER_FREQ)
+
+/* Shortest and longest one-shot countdowns the PIT is given. */
+#define ONESHOT_MIN 16
+#define ONESHOT_MAX 65535
+
+/* Normally the PIT interrupts once per tick.  The timer switches
+   it to one-shot mode to interrupt in the middle of a tick, for
+   a sleeper that must wake there, and to skip ticks while the
+   CPU is idle.  Times are counted in PIT cycles.  The "phase" is
+   the time since the start of the current tick, when TICKS was
+   last incremented. */
+static bool oneshot;            /* PIT in one-shot mode? */
+static int64_t oneshot_start;   /* Phase when the countdown began. */
+static int64_t oneshot_len;     /* Length of the countdown. */
+static int64_t skipped_ticks;   /* Ticks not interrupted for. */
+
+/* Sleeping threads, in a binary min-heap ordered by wake-up
+   time, so that the timer interrupt only looks at the threads
+   that are due.  The heap grows in sleep_until(), never in the
+   interrupt handler. */
+static struct thread **sleep_heap;
+static size_t sleep_cnt;        /* Threads in the heap. */
+static size_t sleep_cap;        /* Capacity of sleep_heap. */
+
+static void sleep_until (int64_t wake);
+static void sleep_grow (void);
+static void sleep_push (struct thread *);
+static struct thread *sleep_pop (void);
+static int64_t timer_phase (bool *pending);
+static void timer_program (int64_t phase, bool idle);
+static void timer_reprogram (bool idle);
+/**********************************************************/
+
 static intr_handler_func timer_interrupt;
 static bool too_many_loops (unsigned loops);
 static void busy_wait (int64_t loops);
@@ -93,18 +133,34 @@ timer_sleep (int64_t ticks)
   /**pj3*****************************************************/
   ASSERT (intr_get_level () == INTR_ON);
 
-  struct thread *t = thread_current();
-  enum intr_level old_level;
- 
-  ASSERT(!intr_context());
-  old_level = intr_disable();
-  t->tick = start + ticks;
-  list_insert_ordered(&sleep_list, &t->elem, p_cmp, 0);
-  thread_block();
-  intr_set_level(old_level);
+  //wake up at the start of tick START + TICKS
+  sleep_until ((start + ticks) * TICK_CYCLES);
   /**********************************************************/
 }
 
+/**pj3*****************************************************/
+/* Called by the idle thread, with interrupts off, before it
+   halts: lets the PIT skip the ticks until the next timer
+   event. */
+void
+timer_idle (void)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+  timer_reprogram (true);
+}
+
+/* Called by the scheduler, with interrupts off, when the idle
+   thread gives way to another thread: goes back to a tick every
+   TIMER_FREQ'th of a second. */
+void
+timer_idle_exit (void)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+  if (oneshot)
+    timer_reprogram (false);
+}
+/**********************************************************/
+
 /* Sleeps for approximately MS milliseconds.  Interrupts must be
    turned on. */
 void
@@ -173,31 +229,260 @@ void
 timer_print_stats (void) 
 {
   printf ("Timer: %"PRId64" ticks\n", timer_ticks ());
+  printf ("Timer: %"PRId64" ticks skipped while idle\n", skipped_ticks);
 }
 
 /* Timer interrupt handler. */
 static void
 timer_interrupt (struct intr_frame *args UNUSED)
 {
-  ticks++;
-  thread_tick ();
   /**pj3*****************************************************/
-  struct thread *t;
-  struct list_elem *e_curr, *e_end;
-  e_curr = list_begin(&sleep_list);
-  e_end = list_end(&sleep_list);
-  while(e_curr != e_end){
-    t = list_entry(e_curr, struct thread, elem);
-    if(t->tick <= ticks){
-	  e_curr = list_remove(e_curr);
-	  thread_unblock(t);
+  int64_t phase = 0;
+
+  if (oneshot){
+	//the countdown ended PHASE cycles into a tick; the CPU was
+	//idle for all but the last of the boundaries it crossed
+	int64_t end = oneshot_start + oneshot_len;
+	int64_t n = end / TICK_CYCLES;
+	if (n > 1){
+	  ticks += n - 1;
+	  skipped_ticks += n - 1;
+	  thread_idle_ticks (n - 1);
 	}
-	else
-	  e_curr = list_next(e_curr);
+	phase = end % TICK_CYCLES;
+	if (n > 0){
+	  ticks++;
+	  thread_tick ();
+	}
+  }
+  else{
+	ticks++;
+	thread_tick ();
   }
+
+  while (sleep_cnt > 0 && sleep_heap[0]->wake <= ticks * TICK_CYCLES + phase)
+	thread_unblock (sleep_pop ());
+  timer_program (phase, thread_cpu_idle ());
   /**********************************************************/
 }
 
+/**pj3*****************************************************/
+/* Blocks the current thread until time WAKE, in PIT cycles since
+   boot.  Interrupts must be on. */
+static void
+sleep_until (int64_t wake)
+{
+  struct thread *t = thread_current ();
+  enum intr_level old_level;
+
+  ASSERT (!intr_context ());
+  old_level = intr_disable ();
+  while (sleep_cnt == sleep_cap)
+    {
+      intr_set_level (old_level);
+      sleep_grow ();
+      old_level = intr_disable ();
+    }
+  t->wake = wake;
+  sleep_push (t);
+  if (sleep_heap[0] == t)
+    timer_reprogram (false);
+  thread_block ();
+  intr_set_level (old_level);
+}
+
+/* Returns true if the PIC holds a timer interrupt that the CPU
+   has not taken yet. */
+static bool
+timer_irq_pending (void)
+{
+  outb (0x20, 0x0a);            /* OCW3: read the IRR. */
+  return (inb (0x20) & 1) != 0;
+}
+
+/* Returns the phase now.  Sets *PENDING to true if the timer
+   interrupt that ends the current tick or countdown is waiting
+   to be taken, in which case the phase may exceed a tick.
+   Interrupts must be off. */
+static int64_t
+timer_phase (bool *pending)
+{
+  bool before;
+  uint16_t count;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (oneshot)
+    {
+      /* Past 0, the count wraps around to 65535. */
+      count = pit_read_count (pending);
+      return oneshot_start + oneshot_len
+             + (*pending ? (uint16_t) (0x10000 - count) : -(int64_t) count);
+    }
+
+  /* In periodic mode the count runs from TICK_CYCLES down to 1
+     and reloads.  Check for a reload around reading it. */
+  before = timer_irq_pending ();
+  count = pit_read_count (NULL);
+  *pending = timer_irq_pending ();
+  if (*pending && !before)
+    count = pit_read_count (NULL);
+  return TICK_CYCLES - count + (*pending ? TICK_CYCLES : 0);
+}
+
+/* Programs the PIT, PHASE cycles into the current tick, for the
+   next timer event: the first sleeper, if it wakes before the
+   next tick boundary, or else that boundary.  If IDLE, boundaries
+   that nothing needs are skipped, up to the next sleeper, the
+   next MLFQS load average update, or the longest countdown the
+   PIT can do.  Interrupts must be off. */
+static void
+timer_program (int64_t phase, bool idle)
+{
+  int64_t base = ticks * TICK_CYCLES;
+  int64_t target = TICK_CYCLES;
+  int64_t len;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (sleep_cnt > 0 && sleep_heap[0]->wake - base < TICK_CYCLES)
+    target = sleep_heap[0]->wake - base;
+  else if (idle)
+    {
+      int64_t end = (phase + ONESHOT_MAX) / TICK_CYCLES;
+      if (sleep_cnt > 0)
+        {
+          int64_t first = DIV_ROUND_UP (sleep_heap[0]->wake - base, TICK_CYCLES);
+          end = first < end ? first : end;
+        }
+      if (thread_mlfqs && TIMER_FREQ - ticks % TIMER_FREQ < end)
+        end = TIMER_FREQ - ticks % TIMER_FREQ;
+      if (end > 1)
+        target = end * TICK_CYCLES;
+    }
+
+  if (target == TICK_CYCLES)
+    {
+      /* Periodic mode only restarts on a tick boundary. */
+      if (!oneshot)
+        return;
+      if (phase == 0)
+        {
+          pit_configure_channel (0, 2, TIMER_FREQ);
+          oneshot = false;
+          return;
+        }
+    }
+
+  len = target - phase;
+  if (len < ONESHOT_MIN)
+    len = ONESHOT_MIN;
+  if (len > ONESHOT_MAX)
+    len = ONESHOT_MAX;
+  pit_oneshot (len);
+  oneshot = true;
+  oneshot_start = phase;
+  oneshot_len = len;
+}
+
+/* Programs the PIT for the next timer event from outside the
+   timer interrupt, unless that interrupt is about to do it.  An
+   idle countdown may be cut short by another interrupt after it
+   has crossed tick boundaries; those ticks were skipped while
+   idle and are counted here, before the countdown is replaced. */
+static void
+timer_reprogram (bool idle)
+{
+  bool pending;
+  int64_t phase = timer_phase (&pending);
+  int64_t n = phase / TICK_CYCLES;
+
+  if (pending)
+    return;
+  if (n > 0)
+    {
+      ticks += n;
+      skipped_ticks += n;
+      thread_idle_ticks (n);
+      phase %= TICK_CYCLES;
+    }
+  timer_program (phase, idle);
+}
+
+/* Doubles the capacity of sleep_heap. */
+static void
+sleep_grow (void)
+{
+  size_t cap = sleep_cap ? sleep_cap * 2 : 64;
+  struct thread **heap = malloc (cap * sizeof *heap);
+  enum intr_level old_level;
+
+  if (heap == NULL)
+    PANIC ("timer_sleep: out of memory");
+
+  /* Another thread may have grown the heap meanwhile. */
+  old_level = intr_disable ();
+  if (cap > sleep_cap)
+    {
+      struct thread **old = sleep_heap;
+      memcpy (heap, old, sleep_cnt * sizeof *heap);
+      sleep_heap = heap;
+      sleep_cap = cap;
+      heap = old;
+    }
+  intr_set_level (old_level);
+  free (heap);
+}
+
+/* Adds T to sleep_heap, which must have room for it.
+   Interrupts must be off. */
+static void
+sleep_push (struct thread *t)
+{
+  size_t i = sleep_cnt++;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (sleep_cnt <= sleep_cap);
+
+  /* Sift up. */
+  while (i > 0 && sleep_heap[(i - 1) / 2]->wake > t->wake)
+    {
+      sleep_heap[i] = sleep_heap[(i - 1) / 2];
+      i = (i - 1) / 2;
+    }
+  sleep_heap[i] = t;
+}
+
+/* Removes and returns the thread that wakes up first, which must
+   exist.  Interrupts must be off. */
+static struct thread *
+sleep_pop (void)
+{
+  struct thread *first = sleep_heap[0];
+  struct thread *last = sleep_heap[--sleep_cnt];
+  size_t i = 0;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  /* Sift LAST down from the root. */
+  for (;;)
+    {
+      size_t child = 2 * i + 1;
+      if (child >= sleep_cnt)
+        break;
+      if (child + 1 < sleep_cnt
+          && sleep_heap[child + 1]->wake < sleep_heap[child]->wake)
+        child++;
+      if (sleep_heap[child]->wake >= last->wake)
+        break;
+      sleep_heap[i] = sleep_heap[child];
+      i = child;
+    }
+  sleep_heap[i] = last;
+  return first;
+}
+/**********************************************************/
+
 /* Returns true if LOOPS iterations waits for more than one timer
    tick, otherwise false. */
 static bool
@@ -235,26 +520,30 @@ busy_wait (int64_t loops)
 static void
 real_time_sleep (int64_t num, int32_t denom) 
 {
-  /* Convert NUM/DENOM seconds into timer ticks, rounding down.
+  /* Convert NUM/DENOM seconds into PIT cycles, rounding down.
           
         (NUM / DENOM) s          
-     ---------------------- = NUM * TIMER_FREQ / DENOM ticks. 
-     1 s / TIMER_FREQ ticks
+     ---------------------- = NUM * PIT_HZ / DENOM cycles. 
+     1 s / PIT_HZ cycles
   */
-  int64_t ticks = num * TIMER_FREQ / denom;
+  int64_t cycles = num * PIT_HZ / denom;
 
   ASSERT (intr_get_level () == INTR_ON);
-  if (ticks > 0)
+  if (cycles >= ONESHOT_MIN)
     {
-      /* We're waiting for at least one full timer tick.  Use
-         timer_sleep() because it will yield the CPU to other
-         processes. */                
-      timer_sleep (ticks); 
+      /* Sleep to the exact PIT cycle, which a one-shot timer
+         interrupt can hit even in the middle of a tick, and
+         yield the CPU to other processes meanwhile. */
+      enum intr_level old_level = intr_disable ();
+      bool pending;
+      int64_t now = ticks * TICK_CYCLES + timer_phase (&pending);
+      intr_set_level (old_level);
+      sleep_until (now + cycles);
     }
   else 
     {
-      /* Otherwise, use a busy-wait loop for more accurate
-         sub-tick timing. */
+      /* Otherwise, use a busy-wait loop: it is too short for a
+         timer interrupt. */
       real_time_delay (num, denom); 
     }
 }
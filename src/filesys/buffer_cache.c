@@ -1,6 +1,7 @@
 #include <string.h>
 #include "filesys/buffer_cache.h"
 #include "filesys/filesys.h"
+#include "threads/trace.h"
 
 static int clock_hand;
 static struct buffer_cache_entry cache[NUM_CACHE];
@@ -19,6 +20,7 @@ void buffer_cache_init(void){
 
 bool buffer_cache_read(block_sector_t sector, void *buffer, off_t ofs, int chunk_size, int sector_ofs){
   struct buffer_cache_entry *bce = buffer_cache_lookup(sector);
+  trace_event(bce ? TRACE_CACHE_HIT : TRACE_CACHE_MISS, sector, 0);
   if(!bce){
 	bce = buffer_cache_select_victim();
 	buffer_cache_flush_entry(bce);
@@ -39,6 +41,7 @@ bool buffer_cache_read(block_sector_t sector, void *buffer, off_t ofs, int chunk
 
 bool buffer_cache_write(block_sector_t sector, void *buffer, off_t ofs, int chunk_size, int sector_ofs){
   struct buffer_cache_entry *bce = buffer_cache_lookup(sector);
+  trace_event(bce ? TRACE_CACHE_HIT : TRACE_CACHE_MISS, sector, 1);
   if(!bce){
 	bce = buffer_cache_select_victim();
 	buffer_cache_flush_entry(bce);
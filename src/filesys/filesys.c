@@ -27,6 +27,8 @@ filesys_init (bool format)
 
   buffer_cache_init();
   inode_init ();
+  file_init ();
+  dir_init ();
   free_map_init ();
 
   if (format) 
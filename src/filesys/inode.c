@@ -6,6 +6,7 @@
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
 #include "threads/malloc.h"
+#include "threads/slab.h"
 #include "filesys/buffer_cache.h"
 
 #define DIRECT_ENTRIES 123
@@ -83,11 +84,24 @@ byte_to_sector (const struct inode_disk *disk_inode, off_t pos)
    returns the same `struct inode'. */
 static struct list open_inodes;
 
+/* Cache of struct inode.  Its objects keep their I_LOCK from
+   one use to the next. */
+static struct kmem_cache *inode_cache;
+
+/* Constructs inode I for inode_cache. */
+static void
+inode_ctor (void *i)
+{
+  struct inode *inode = i;
+  lock_init (&inode->i_lock);
+}
+
 /* Initializes the inode module. */
 void
 inode_init (void) 
 {
   list_init (&open_inodes);
+  inode_cache = kmem_cache_create ("inode", sizeof (struct inode), inode_ctor);
 //  memset(zeros, 0, BLOCK_SECTOR_SIZE);
 }
 
@@ -184,7 +198,7 @@ inode_open (block_sector_t sector)
     }
 
   /* Allocate memory. */
-  inode = malloc (sizeof *inode);
+  inode = kmem_cache_alloc (inode_cache);
   if (inode == NULL)
     return NULL;
 
@@ -194,7 +208,6 @@ inode_open (block_sector_t sector)
   inode->open_cnt = 1;
   inode->deny_write_cnt = 0;
   inode->removed = false;
-  lock_init(&inode->i_lock);
   return inode;
 }
 
@@ -239,7 +252,7 @@ inode_close (struct inode *inode)
           free_map_release (inode->sector, 1);
         }
 
-      free (inode); 
+      kmem_cache_free (inode_cache, inode);
     }
 }
 
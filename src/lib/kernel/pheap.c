@@ -0,0 +1,155 @@
+/* Pairing heap.
+
+   See pheap.h for basic information.  The heap is a tree whose
+   every node is at least as great as its children.  Each node
+   keeps its children in a doubly linked list, in which the first
+   child's `prev' points to the parent. */
+
+#include "pheap.h"
+#include "../debug.h"
+
+static struct pheap_elem *meld (struct pheap *,
+                                struct pheap_elem *, struct pheap_elem *);
+static struct pheap_elem *merge_pairs (struct pheap *, struct pheap_elem *);
+
+/* Initializes heap H to be empty, ordered by LESS given
+   auxiliary data AUX. */
+void
+pheap_init (struct pheap *h, pheap_less_func *less, void *aux) 
+{
+  ASSERT (h != NULL);
+  ASSERT (less != NULL);
+
+  h->root = NULL;
+  h->less = less;
+  h->aux = aux;
+}
+
+/* Returns true if H contains no elements. */
+bool
+pheap_empty (const struct pheap *h) 
+{
+  return h->root == NULL;
+}
+
+/* Returns the greatest element in H, or a null pointer if H is
+   empty. */
+struct pheap_elem *
+pheap_front (const struct pheap *h) 
+{
+  return h->root;
+}
+
+/* Inserts E into H. */
+void
+pheap_insert (struct pheap *h, struct pheap_elem *e) 
+{
+  ASSERT (e != NULL);
+
+  e->child = e->next = e->prev = NULL;
+  h->root = h->root != NULL ? meld (h, h->root, e) : e;
+}
+
+/* Removes and returns the greatest element in H, which must not
+   be empty. */
+struct pheap_elem *
+pheap_pop_front (struct pheap *h) 
+{
+  struct pheap_elem *e = h->root;
+
+  ASSERT (e != NULL);
+  h->root = merge_pairs (h, e->child);
+  return e;
+}
+
+/* Removes E, which must be in H, from H. */
+void
+pheap_remove (struct pheap *h, struct pheap_elem *e) 
+{
+  struct pheap_elem *sub;
+
+  ASSERT (e != NULL);
+
+  if (e == h->root) 
+    {
+      pheap_pop_front (h);
+      return;
+    }
+
+  /* Unlink E from its parent or previous sibling. */
+  if (e->prev->child == e)
+    e->prev->child = e->next;
+  else
+    e->prev->next = e->next;
+  if (e->next != NULL)
+    e->next->prev = e->prev;
+
+  sub = merge_pairs (h, e->child);
+  if (sub != NULL)
+    h->root = meld (h, h->root, sub);
+}
+
+/* Joins the trees rooted at A and B, neither of which may have
+   siblings, and returns the root of the result. */
+static struct pheap_elem *
+meld (struct pheap *h, struct pheap_elem *a, struct pheap_elem *b) 
+{
+  if (h->less (a, b, h->aux)) 
+    {
+      struct pheap_elem *t = a;
+      a = b;
+      b = t;
+    }
+
+  /* Make B the first child of A. */
+  b->next = a->child;
+  if (a->child != NULL)
+    a->child->prev = b;
+  b->prev = a;
+  a->child = b;
+  return a;
+}
+
+/* Joins the list of sibling trees starting at FIRST into a single
+   tree and returns its root, or a null pointer if FIRST is null.
+   Melds the trees pairwise from left to right, then the pairs
+   from right to left, which keeps the amortized cost of a
+   removal logarithmic. */
+static struct pheap_elem *
+merge_pairs (struct pheap *h, struct pheap_elem *first) 
+{
+  struct pheap_elem *pairs = NULL;
+  struct pheap_elem *root = NULL;
+
+  /* First pass: meld pairs, stacking the results on PAIRS
+     through their `next' members. */
+  while (first != NULL) 
+    {
+      struct pheap_elem *a = first;
+      struct pheap_elem *b = a->next;
+
+      first = b != NULL ? b->next : NULL;
+      a->next = a->prev = NULL;
+      if (b != NULL) 
+        {
+          b->next = b->prev = NULL;
+          a = meld (h, a, b);
+        }
+      a->next = pairs;
+      pairs = a;
+    }
+
+  /* Second pass: meld the pairs into one tree, last pair
+     first. */
+  while (pairs != NULL) 
+    {
+      struct pheap_elem *next = pairs->next;
+
+      pairs->next = NULL;
+      root = root != NULL ? meld (h, root, pairs) : pairs;
+      pairs = next;
+    }
+  if (root != NULL)
+    root->prev = NULL;
+  return root;
+}
@@ -0,0 +1,61 @@
+#ifndef __LIB_KERNEL_PHEAP_H
+#define __LIB_KERNEL_PHEAP_H
+
+/* Pairing heap.
+
+   A priority queue that keeps its greatest element, according
+   to a caller-supplied comparison function, at the front.
+   Finding the front and inserting take constant time; removing
+   the front, or any other element, takes amortized logarithmic
+   time.  An element whose key changes must be removed and
+   inserted again.
+
+   Like the linked list and the hash table, the heap does not use
+   dynamic allocation.  Each structure that can be in a heap
+   embeds a struct pheap_elem member, and pheap_entry converts a
+   pointer to that member back into the outer structure.  Refer
+   to lib/kernel/list.h for a detailed explanation. */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Heap element. */
+struct pheap_elem 
+  {
+    struct pheap_elem *child;   /* First child. */
+    struct pheap_elem *next;    /* Next sibling. */
+    struct pheap_elem *prev;    /* Previous sibling, or parent. */
+  };
+
+/* Converts pointer to heap element PHEAP_ELEM into a pointer to
+   the structure that PHEAP_ELEM is embedded inside.  Supply the
+   name of the outer structure STRUCT and the member name MEMBER
+   of the heap element. */
+#define pheap_entry(PHEAP_ELEM, STRUCT, MEMBER)                 \
+        ((STRUCT *) ((uint8_t *) (PHEAP_ELEM)                   \
+                     - offsetof (STRUCT, MEMBER)))
+
+/* Compares the value of two heap elements A and B, given
+   auxiliary data AUX.  Returns true if A is less than B, or
+   false if A is greater than or equal to B. */
+typedef bool pheap_less_func (const struct pheap_elem *a,
+                              const struct pheap_elem *b,
+                              void *aux);
+
+/* Pairing heap. */
+struct pheap 
+  {
+    struct pheap_elem *root;    /* Greatest element, or null. */
+    pheap_less_func *less;      /* Comparison function. */
+    void *aux;                  /* Auxiliary data for `less'. */
+  };
+
+void pheap_init (struct pheap *, pheap_less_func *, void *aux);
+bool pheap_empty (const struct pheap *);
+struct pheap_elem *pheap_front (const struct pheap *);
+void pheap_insert (struct pheap *, struct pheap_elem *);
+struct pheap_elem *pheap_pop_front (struct pheap *);
+void pheap_remove (struct pheap *, struct pheap_elem *);
+
+#endif /* lib/kernel/pheap.h */
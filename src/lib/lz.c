@@ -0,0 +1,198 @@
+#include "lz.h"
+#include <stdbool.h>
+#include <string.h>
+#include "debug.h"
+
+/* A small LZ77 compressor in the style of LZ4.
+
+   The output is a series of sequences.  Each sequence starts
+   with a token byte whose high nibble is a count of literal
+   bytes and whose low nibble is a match length minus
+   MIN_MATCH.  A nibble of 15 is followed by extra length bytes,
+   each added to it, up to and including the first that is not
+   255.  Then come the literal bytes themselves, a 2-byte
+   little-endian offset back into the output, and the extra
+   match length bytes, if any.  The last sequence stops after
+   its literals.
+
+   Offsets are 16 bits, so inputs are limited to 64 kB, which
+   is plenty for compressing single pages. */
+
+/* Shortest match worth encoding. */
+#define MIN_MATCH 4
+
+/* Returns the 4 bytes at P as a 32-bit integer. */
+static inline uint32_t
+read32 (const uint8_t *p)
+{
+  uint32_t v;
+  memcpy (&v, p, sizeof v);
+  return v;
+}
+
+/* Hashes the 4 bytes in V into a lz_compress() table index. */
+static inline unsigned
+hash (uint32_t v)
+{
+  return (v * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+/* Writes the extra length bytes for LEN at OP, which may not
+   reach OEND.  Returns the new output position, or a null
+   pointer if the output is full. */
+static uint8_t *
+put_len (uint8_t *op, uint8_t *oend, size_t len)
+{
+  for (;;)
+    {
+      if (op >= oend)
+        return NULL;
+      *op++ = len < 255 ? len : 255;
+      if (len < 255)
+        return op;
+      len -= 255;
+    }
+}
+
+/* Reads extra length bytes at *IP, which may not reach IEND,
+   and adds them to *LEN.  Returns false if the input ends
+   first. */
+static bool
+get_len (const uint8_t **ip, const uint8_t *iend, size_t *len)
+{
+  unsigned b;
+
+  do
+    {
+      if (*ip >= iend)
+        return false;
+      b = *(*ip)++;
+      *len += b;
+    }
+  while (b == 255);
+  return true;
+}
+
+/* Writes a sequence of LIT_LEN literal bytes from LIT followed
+   by a MATCH_LEN byte match OFFSET bytes back at OP, which may
+   not reach OEND.  A MATCH_LEN of 0 writes the last sequence.
+   Returns the new output position, or a null pointer if the
+   output is full. */
+static uint8_t *
+put_sequence (uint8_t *op, uint8_t *oend, const uint8_t *lit,
+              size_t lit_len, size_t offset, size_t match_len)
+{
+  size_t extra = match_len ? match_len - MIN_MATCH : 0;
+
+  if (op >= oend)
+    return NULL;
+  *op++ = (lit_len < 15 ? lit_len : 15) << 4 | (extra < 15 ? extra : 15);
+  if (lit_len >= 15 && (op = put_len (op, oend, lit_len - 15)) == NULL)
+    return NULL;
+  if ((size_t) (oend - op) < lit_len)
+    return NULL;
+  memcpy (op, lit, lit_len);
+  op += lit_len;
+  if (match_len == 0)
+    return op;
+
+  if (oend - op < 2)
+    return NULL;
+  *op++ = offset & 0xff;
+  *op++ = offset >> 8;
+  if (extra >= 15 && (op = put_len (op, oend, extra - 15)) == NULL)
+    return NULL;
+  return op;
+}
+
+/* Compresses the SRC_SIZE bytes at SRC into the DST_SIZE bytes
+   at DST, using WORK, which must be LZ_WORK_SIZE bytes, as
+   scratch space.  Returns the compressed size, or 0 if it would
+   exceed DST_SIZE. */
+size_t
+lz_compress (const void *src_, size_t src_size,
+             void *dst_, size_t dst_size, void *work)
+{
+  const uint8_t *src = src_;
+  const uint8_t *end = src + src_size;
+  const uint8_t *ip = src, *anchor = src;
+  uint8_t *dst = dst_, *op = dst, *oend = dst + dst_size;
+  uint16_t *table = work;
+
+  ASSERT (src_size <= 65536);
+
+  memset (table, 0, LZ_WORK_SIZE);
+  while (end - ip >= MIN_MATCH)
+    {
+      uint32_t v = read32 (ip);
+      unsigned h = hash (v);
+      const uint8_t *ref = src + table[h];
+      size_t len;
+
+      table[h] = ip - src;
+      if (ref >= ip || read32 (ref) != v)
+        {
+          ip++;
+          continue;
+        }
+
+      len = MIN_MATCH;
+      while (ip + len < end && ref[len] == ip[len])
+        len++;
+      op = put_sequence (op, oend, anchor, ip - anchor, ip - ref, len);
+      if (op == NULL)
+        return 0;
+      ip += len;
+      anchor = ip;
+    }
+
+  op = put_sequence (op, oend, anchor, end - anchor, 0, 0);
+  return op != NULL ? (size_t) (op - dst) : 0;
+}
+
+/* Decompresses the SRC_SIZE bytes at SRC, as written by
+   lz_compress(), into the DST_SIZE bytes at DST.  Returns the
+   decompressed size, or 0 if the input is malformed or would
+   not fit in DST_SIZE. */
+size_t
+lz_decompress (const void *src_, size_t src_size,
+               void *dst_, size_t dst_size)
+{
+  const uint8_t *ip = src_, *iend = ip + src_size;
+  uint8_t *dst = dst_, *op = dst, *oend = dst + dst_size;
+
+  while (ip < iend)
+    {
+      unsigned token = *ip++;
+      const uint8_t *ref;
+      size_t offset, len;
+
+      /* Literals. */
+      len = token >> 4;
+      if (len == 15 && !get_len (&ip, iend, &len))
+        return 0;
+      if ((size_t) (iend - ip) < len || (size_t) (oend - op) < len)
+        return 0;
+      memcpy (op, ip, len);
+      op += len;
+      ip += len;
+      if (ip == iend)
+        break;
+
+      /* Match, which may overlap its own output. */
+      if (iend - ip < 2)
+        return 0;
+      offset = ip[0] | ip[1] << 8;
+      ip += 2;
+      len = token & 15;
+      if (len == 15 && !get_len (&ip, iend, &len))
+        return 0;
+      len += MIN_MATCH;
+      if (offset == 0 || offset > (size_t) (op - dst)
+          || (size_t) (oend - op) < len)
+        return 0;
+      for (ref = op - offset; len > 0; len--)
+        *op++ = *ref++;
+    }
+  return op - dst;
+}
@@ -0,0 +1,27 @@
+#ifndef __LIB_SCHEDSTAT_H
+#define __LIB_SCHEDSTAT_H
+
+/* Scheduler statistics of one thread, as returned by the
+   schedstat() system call.  Times are in CPU cycles. */
+
+/* Wakeup latency histogram: latency[I] counts the wakeups that
+   took from 2**(I + SCHEDSTAT_LAT_SHIFT) up to twice that many
+   cycles between thread_unblock() and running.  The first and
+   last buckets are open ended. */
+#define SCHEDSTAT_LAT_SHIFT 10
+#define SCHEDSTAT_LAT_BUCKETS 24
+
+struct schedstat
+  {
+    long long run_time;         /* Time running. */
+    long long ready_time;       /* Time ready but not running. */
+    long long blocked_time;     /* Time blocked. */
+    unsigned voluntary;         /* Switches away by blocking. */
+    unsigned involuntary;       /* Switches away while still ready. */
+    unsigned latency[SCHEDSTAT_LAT_BUCKETS];
+  };
+
+/* Whose statistics schedstat() returns, other than a tid. */
+#define SCHEDSTAT_SELF 0        /* The calling thread. */
+
+#endif /* lib/schedstat.h */
@@ -33,6 +33,10 @@ enum
 /**pj1**************************************************/
 	SYS_FIBO,
 	SYS_MAX_FOUR,
+/**pj4**************************************************/
+	SYS_FORK,                   /* Clone this process. */
+	SYS_VMSTAT,                 /* Get virtual memory statistics. */
+	SYS_SCHEDSTAT,              /* Get scheduler statistics. */
 /****************************************************/
 
   };
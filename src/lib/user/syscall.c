@@ -210,4 +210,23 @@ int fibonacci (int n){
 int max_of_four_int(int a, int b, int c, int d){
   return syscall4 (SYS_MAX_FOUR, a, b, c, d);
 }
+/**pj4************************************************/
+
+pid_t
+fork (void)
+{
+  return (pid_t) syscall0 (SYS_FORK);
+}
+
+bool
+vmstat (int which, struct vmstat *st)
+{
+  return syscall2 (SYS_VMSTAT, which, st);
+}
+
+bool
+schedstat (pid_t pid, struct schedstat *st)
+{
+  return syscall2 (SYS_SCHEDSTAT, pid, st);
+}
 /*****************************************************/
@@ -3,6 +3,8 @@
 
 #include <stdbool.h>
 #include <debug.h>
+#include <vmstat.h>
+#include <schedstat.h>
 
 /* Process identifier. */
 typedef int pid_t;
@@ -48,6 +50,10 @@ int inumber (int fd);
 /**pj1************************************************/
 int fibonacci (int n);
 int max_of_four_int(int a, int b, int c, int d);
+/**pj4************************************************/
+pid_t fork (void);
+bool vmstat (int which, struct vmstat *);
+bool schedstat (pid_t, struct schedstat *);
 /*****************************************************/
 
 #endif /* lib/user/syscall.h */
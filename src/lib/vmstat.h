@@ -0,0 +1,28 @@
+#ifndef __LIB_VMSTAT_H
+#define __LIB_VMSTAT_H
+
+/* Virtual memory statistics, as returned by the vmstat() system
+   call.  The counters are kept for every process and for the
+   whole system; the rest describes the system at the time of
+   the call. */
+struct vmstat
+  {
+    long long minor_faults;     /* Faults resolved without I/O. */
+    long long major_faults;     /* Faults that read a page from swap. */
+    long long stack_faults;     /* Faults that grew the stack. */
+    long long swap_ins;         /* Pages read back from swap. */
+    long long swap_outs;        /* Pages written to swap. */
+    long long evictions;        /* Frames evicted to satisfy allocations. */
+
+    int frames;                 /* User frames in use. */
+    int pinned_frames;          /* Frames that cannot be evicted. */
+    int swap_slots;             /* Swap disk slots. */
+    int swap_slots_used;        /* Swap disk slots in use. */
+    int zip_pages;              /* Pages in compressed swap. */
+  };
+
+/* Which counters vmstat() returns. */
+#define VMSTAT_SELF 0           /* The calling process. */
+#define VMSTAT_ALL 1            /* The whole system. */
+
+#endif /* lib/vmstat.h */
@@ -0,0 +1,35 @@
+/* Checks that schedstat() accounts the time a process spends
+   running and blocked and its voluntary switches, and that it
+   fails for a thread that no longer exists. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  struct schedstat busy, waited, st;
+  volatile int i;
+  pid_t child;
+
+  msg ("busy loop");
+  for (i = 0; i < 10000000; i++)
+    continue;
+  CHECK (schedstat (SCHEDSTAT_SELF, &busy), "schedstat after busy loop");
+  if (busy.run_time <= 0)
+    fail ("run_time is %lld", busy.run_time);
+
+  /* Waiting for a child blocks. */
+  CHECK (wait (child = exec ("child-simple")) == 81,
+         "wait(exec(\"child-simple\"))");
+  CHECK (schedstat (SCHEDSTAT_SELF, &waited), "schedstat after waiting");
+  if (waited.run_time < busy.run_time)
+    fail ("run_time went down");
+  if (waited.blocked_time <= 0)
+    fail ("blocked_time is %lld", waited.blocked_time);
+  if (waited.voluntary < 1)
+    fail ("no voluntary switches");
+
+  CHECK (!schedstat (child, &st), "schedstat of an exited thread fails");
+}
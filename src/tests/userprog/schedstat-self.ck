@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(schedstat-self) begin
+(schedstat-self) busy loop
+(schedstat-self) schedstat after busy loop
+(schedstat-self) wait(exec("child-simple"))
+(child-simple) run
+child-simple: exit(81)
+(schedstat-self) schedstat after waiting
+(schedstat-self) schedstat of an exited thread fails
+(schedstat-self) end
+schedstat-self: exit(0)
+EOF
+pass;
@@ -0,0 +1,43 @@
+/* Writes to a file and to the console several times in a row,
+   reads the file back, and exits, to check that write() leaves
+   the buffer it copies through intact from one call to the
+   next. */
+
+#include <stdio.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define WRITE_CNT 4
+
+static char buf[sizeof sample - 1];
+
+void
+test_main (void) 
+{
+  static const char line[] = "(write-repeat) console line\n";
+  int handle, byte_cnt, i;
+
+  CHECK (create ("test.txt", WRITE_CNT * (sizeof sample - 1)),
+         "create \"test.txt\"");
+  CHECK ((handle = open ("test.txt")) > 1, "open \"test.txt\"");
+  for (i = 0; i < WRITE_CNT; i++)
+    {
+      byte_cnt = write (handle, sample, sizeof sample - 1);
+      if (byte_cnt != sizeof sample - 1)
+        fail ("write %d returned %d instead of %zu",
+              i, byte_cnt, sizeof sample - 1);
+    }
+  for (i = 0; i < WRITE_CNT; i++)
+    write (STDOUT_FILENO, line, sizeof line - 1);
+
+  msg ("read back \"test.txt\"");
+  seek (handle, 0);
+  for (i = 0; i < WRITE_CNT; i++)
+    if (read (handle, buf, sizeof buf) != sizeof buf
+        || memcmp (buf, sample, sizeof buf))
+      fail ("copy %d in \"test.txt\" differs from what was written", i);
+  close (handle);
+}
@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(write-repeat) begin
+(write-repeat) create "test.txt"
+(write-repeat) open "test.txt"
+(write-repeat) console line
+(write-repeat) console line
+(write-repeat) console line
+(write-repeat) console line
+(write-repeat) read back "test.txt"
+(write-repeat) end
+write-repeat: exit(0)
+EOF
+pass;
@@ -0,0 +1,49 @@
+/* Forks a child, then has the parent and the child each write
+   to pages they started out sharing, and verifies that each of
+   them sees only its own writes. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_CNT 16
+
+static char buf[PAGE_CNT * 4096];
+
+/* Fails unless every byte of BUF is C. */
+static void
+check_buf (char c, const char *who)
+{
+  size_t i;
+
+  for (i = 0; i < sizeof buf; i++)
+    if (buf[i] != c)
+      fail ("%s: byte %zu is %#x, not %#x", who, i, buf[i], c);
+}
+
+void
+test_main (void)
+{
+  pid_t child;
+
+  memset (buf, 'a', sizeof buf);
+
+  msg ("fork");
+  child = fork ();
+  if (child == 0)
+    {
+      memset (buf, 'c', sizeof buf);
+      check_buf ('c', "child");
+      exit (81);
+    }
+  if (child == -1)
+    fail ("fork returned -1");
+
+  memset (buf, 'p', sizeof buf);
+  check_buf ('p', "parent");
+  if (wait (child) != 81)
+    fail ("child saw the wrong data");
+  check_buf ('p', "parent after wait");
+  msg ("parent and child kept their own copies");
+}
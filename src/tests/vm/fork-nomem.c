@@ -0,0 +1,70 @@
+/* Forks a chain of processes, each the child of the one before,
+   until memory runs out and fork() fails.  Each copies a buffer
+   that is mostly in swap, so memory runs out after a few levels.
+   Then verifies that the parent's data survived and that, once
+   the chain has exited, fork() works again. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_CNT 256
+#define PAGE_SIZE 4096
+
+static char buf[PAGE_CNT * PAGE_SIZE];
+
+/* Forks the rest of the chain from a process DEPTH levels down
+   and exits with the depth of the deepest process that could be
+   created. */
+static void
+fork_chain (int depth)
+{
+  for (;;)
+    {
+      pid_t child = fork ();
+      int status;
+
+      if (child == 0)
+        {
+          depth++;
+          continue;
+        }
+      if (child == -1)
+        exit (depth);
+      status = wait (child);
+      exit (status < 0 ? depth : status);
+    }
+}
+
+void
+test_main (void)
+{
+  pid_t child;
+  size_t i;
+  int depth;
+
+  for (i = 0; i < PAGE_CNT; i++)
+    memset (buf + i * PAGE_SIZE, i, PAGE_SIZE);
+
+  msg ("fork until out of memory");
+  child = fork ();
+  if (child == 0)
+    fork_chain (1);
+  CHECK (child != -1, "first fork");
+  depth = wait (child);
+  if (depth < 1)
+    fail ("chain exited with %d", depth);
+
+  msg ("verify");
+  for (i = 0; i < PAGE_CNT; i++)
+    if (buf[i * PAGE_SIZE] != (char) i
+        || memcmp (buf + i * PAGE_SIZE, buf + i * PAGE_SIZE + 1,
+                   PAGE_SIZE - 1))
+      fail ("page %zu has bad data", i);
+
+  child = fork ();
+  if (child == 0)
+    exit (81);
+  CHECK (child != -1 && wait (child) == 81, "fork after the chain exited");
+}
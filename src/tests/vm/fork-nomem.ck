@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, IGNORE_USER_FAULTS => 1, [<<'EOF']);
+(fork-nomem) begin
+(fork-nomem) fork until out of memory
+(fork-nomem) first fork
+(fork-nomem) verify
+(fork-nomem) fork after the chain exited
+(fork-nomem) end
+EOF
+pass;
@@ -0,0 +1,64 @@
+/* Fills more memory than the user pool holds, so that some of
+   it is in swap, then forks and verifies that the child sees
+   the same data and that writes by either process stay
+   private. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_CNT 256
+#define PAGE_SIZE 4096
+
+static char buf[PAGE_CNT * PAGE_SIZE];
+
+/* Fails unless page I of BUF is filled with I + DELTA. */
+static void
+check_pages (int delta, const char *who)
+{
+  size_t i, j;
+
+  for (i = 0; i < PAGE_CNT; i++)
+    for (j = 0; j < PAGE_SIZE; j++)
+      if (buf[i * PAGE_SIZE + j] != (char) (i + delta))
+        fail ("%s: page %zu has bad data", who, i);
+}
+
+/* Fills page I of BUF with I + DELTA. */
+static void
+fill_pages (int delta)
+{
+  size_t i;
+
+  for (i = 0; i < PAGE_CNT; i++)
+    memset (buf + i * PAGE_SIZE, i + delta, PAGE_SIZE);
+}
+
+void
+test_main (void)
+{
+  pid_t child;
+
+  msg ("fill");
+  fill_pages (0);
+
+  msg ("fork");
+  child = fork ();
+  if (child == 0)
+    {
+      check_pages (0, "child");
+      fill_pages (1);
+      check_pages (1, "child after write");
+      exit (81);
+    }
+  if (child == -1)
+    fail ("fork returned -1");
+
+  check_pages (0, "parent");
+  fill_pages (2);
+  if (wait (child) != 81)
+    fail ("child saw the wrong data");
+  check_pages (2, "parent after wait");
+  msg ("parent and child kept their own copies");
+}
@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(fork-swap) begin
+(fork-swap) fill
+(fork-swap) fork
+fork-swap: exit(81)
+(fork-swap) parent and child kept their own copies
+(fork-swap) end
+fork-swap: exit(0)
+EOF
+pass;
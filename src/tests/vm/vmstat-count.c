@@ -0,0 +1,48 @@
+/* Writes and then reads back more memory than the user pool
+   holds, and verifies that vmstat() counted the faults and the
+   swapping that took. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_CNT 256
+#define PAGE_SIZE 4096
+
+static char buf[PAGE_CNT * PAGE_SIZE];
+
+void
+test_main (void)
+{
+  struct vmstat before, after, all;
+  size_t i;
+
+  CHECK (vmstat (VMSTAT_SELF, &before), "vmstat before");
+
+  msg ("write");
+  for (i = 0; i < PAGE_CNT; i++)
+    memset (buf + i * PAGE_SIZE, i, PAGE_SIZE);
+  msg ("read");
+  for (i = 0; i < PAGE_CNT; i++)
+    if (buf[i * PAGE_SIZE] != (char) i)
+      fail ("page %zu has bad data", i);
+
+  CHECK (vmstat (VMSTAT_SELF, &after), "vmstat after");
+  if (after.minor_faults <= before.minor_faults)
+    fail ("minor_faults did not go up");
+  if (after.major_faults <= before.major_faults)
+    fail ("major_faults did not go up");
+  if (after.swap_outs <= before.swap_outs)
+    fail ("swap_outs did not go up");
+  if (after.swap_ins <= before.swap_ins)
+    fail ("swap_ins did not go up");
+  msg ("process counters went up");
+
+  CHECK (vmstat (VMSTAT_ALL, &all), "vmstat all");
+  if (all.major_faults < after.major_faults
+      || all.swap_outs < after.swap_outs
+      || all.swap_ins < after.swap_ins)
+    fail ("system counters are below the process's");
+  CHECK (!vmstat (2, &all), "vmstat with a bad selector fails");
+}
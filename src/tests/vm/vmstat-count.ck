@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(vmstat-count) begin
+(vmstat-count) vmstat before
+(vmstat-count) write
+(vmstat-count) read
+(vmstat-count) vmstat after
+(vmstat-count) process counters went up
+(vmstat-count) vmstat all
+(vmstat-count) vmstat with a bad selector fails
+(vmstat-count) end
+vmstat-count: exit(0)
+EOF
+pass;
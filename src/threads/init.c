@@ -22,6 +22,7 @@
 #include "threads/palloc.h"
 #include "threads/pte.h"
 #include "threads/thread.h"
+#include "threads/trace.h"
 #ifdef USERPROG
 #include "userprog/process.h"
 #include "userprog/exception.h"
@@ -41,6 +42,8 @@
 /**pj4******************************************************/
 #ifdef VM
 #include "vm/swap.h"
+#include "vm/frame.h"
+#include "vm/page.h"
 #endif
 /***********************************************************/
 
@@ -60,6 +63,9 @@ static const char *swap_bdev_name;
 #endif
 #endif /* FILESYS */
 
+/* -trace: Record kernel events? */
+static bool trace_boot;
+
 /* -ul: Maximum number of pages to put into palloc's user pool. */
 static size_t user_page_limit = SIZE_MAX;
 
@@ -125,6 +131,8 @@ main (void)
   thread_start ();
   serial_init_queue ();
   timer_calibrate ();
+  if (trace_boot)
+    trace_init ();
 
 
 #ifdef FILESYS
@@ -137,6 +145,9 @@ main (void)
 /**pj4******************************************************/
 #ifdef VM
   swap_init();
+  frame_init();
+  page_init();
+  pageout_start();
 #endif
 /***********************************************************/
 
@@ -163,7 +174,21 @@ bss_init (void)
   memset (&_start_bss, 0, &_end_bss - &_start_bss);
 }
 
-/* Populates the base page directory and page table with the
+#define CPUID_PSE 0x00000008    /* CPUID 1, EDX: 4 MB pages supported. */
+#define CR4_PSE 0x00000010      /* CR4: 4 MB pages enabled. */
+
+/* Returns true if the CPU supports 4 MB pages.  See [IA32-v2a]
+   "CPUID--CPU Identification". */
+static bool
+pse_supported (void)
+{
+  uint32_t eax = 1, ebx, ecx, edx;
+
+  asm volatile ("cpuid" : "+a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx));
+  return (edx & CPUID_PSE) != 0;
+}
+
+/* Populates the base page directory and page tables with the
    kernel virtual mapping, and then sets up the CPU to use the
    new page directory.  Points init_page_dir to the page
    directory it creates. */
@@ -173,6 +198,16 @@ paging_init (void)
   uint32_t *pd, *pt;
   size_t page;
   extern char _start, _end_kernel_text;
+  bool pse = pse_supported ();
+
+  /* Allow 4 MB pages.  See [IA32-v3a] 3.7.3 "Mixing 4-KByte
+     and 4-MByte Pages". */
+  if (pse)
+    {
+      uint32_t cr4;
+      asm volatile ("movl %%cr4, %0" : "=r" (cr4));
+      asm volatile ("movl %0, %%cr4" : : "r" (cr4 | CR4_PSE));
+    }
 
   pd = init_page_dir = palloc_get_page (PAL_ASSERT | PAL_ZERO);
   pt = NULL;
@@ -184,6 +219,17 @@ paging_init (void)
       size_t pte_idx = pt_no (vaddr);
       bool in_kernel_text = &_start <= vaddr && vaddr < &_end_kernel_text;
 
+      /* Map each whole 4 MB of RAM clear of the read-only kernel
+         text with one large page, saving a page table and most
+         of the TLB entries it would take. */
+      if (pse && pte_idx == 0 && page + PTSPAN / PGSIZE <= init_ram_pages
+          && (vaddr + PTSPAN <= &_start || vaddr >= &_end_kernel_text))
+        {
+          pd[pde_idx] = pde_create_kernel_large (vaddr, true);
+          page += PTSPAN / PGSIZE - 1;
+          continue;
+        }
+
       if (pd[pde_idx] == 0)
         {
           pt = palloc_get_page (PAL_ASSERT | PAL_ZERO);
@@ -263,6 +309,10 @@ parse_options (char **argv)
 #ifdef VM
       else if (!strcmp (name, "-swap"))
         swap_bdev_name = value;
+      else if (!strcmp (name, "-rss-soft"))
+        rss_soft_limit = atoi (value);
+      else if (!strcmp (name, "-rss-hard"))
+        rss_hard_limit = atoi (value);
 #endif
 #endif
       else if (!strcmp (name, "-rs"))
@@ -275,6 +325,12 @@ parse_options (char **argv)
         thread_prior_aging = true;
 #endif
 /***********************************************************/
+      else if (!strcmp (name, "-lockprof"))
+        lock_profile = true;
+      else if (!strcmp (name, "-schedstat"))
+        thread_schedstat = true;
+      else if (!strcmp (name, "-trace"))
+        trace_boot = true;
 #ifdef USERPROG
       else if (!strcmp (name, "-ul"))
         user_page_limit = atoi (value);
@@ -394,10 +450,15 @@ usage (void)
           "  -scratch=BDEV      Use BDEV for scratch instead of default.\n"
 #ifdef VM
           "  -swap=BDEV         Use BDEV for swap instead of default.\n"
+          "  -rss-soft=COUNT    Prefer evicting processes above COUNT frames.\n"
+          "  -rss-hard=COUNT    Limit each process to COUNT frames.\n"
 #endif
 #endif
           "  -rs=SEED           Set random number seed to SEED.\n"
           "  -mlfqs             Use multi-level feedback queue scheduler.\n"
+          "  -lockprof          Profile locks, report at power off.\n"
+          "  -schedstat         Report per-thread scheduling at exit.\n"
+          "  -trace             Trace kernel events to the scratch device.\n"
 #ifdef USERPROG
           "  -ul=COUNT          Limit user memory to COUNT pages.\n"
 #endif
@@ -7,6 +7,7 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/interrupt.h"
 #include "threads/loader.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
@@ -25,17 +26,32 @@
    half to the user pool.  That should be huge overkill for the
    kernel pool, but that's just fine for demonstration purposes. */
 
-/* A memory pool. */
+/* A memory pool.  LOCK serializes allocations, so that the
+   bitmap scan runs with interrupts on.  The bitmap and FREE_CNT
+   are only written with interrupts off, which lets
+   palloc_free_multiple() run without the lock, as it must when
+   thread_schedule_tail() frees a dying thread.  A page freed
+   during a scan at worst goes unnoticed by it. */
 struct pool
   {
-    struct lock lock;                   /* Mutual exclusion. */
+    struct lock lock;                   /* Serializes allocations. */
     struct bitmap *used_map;            /* Bitmap of free pages. */
     uint8_t *base;                      /* Base of pool. */
+    size_t free_cnt;                    /* Number of free pages. */
   };
 
 /* Two pools: one for kernel data, one for user pages. */
 static struct pool kernel_pool, user_pool;
 
+/* Free-page watermarks for the user pool.  Once an allocation
+   leaves fewer than LOW_WATER pages free, the page-out daemon
+   is woken up and evicts frames until at least HIGH_WATER pages
+   are free again, so that page faults rarely have to evict
+   synchronously. */
+static size_t low_water, high_water;
+static struct semaphore low_water_sema;  /* Upped when below LOW_WATER. */
+static bool low_water_signaled;          /* LOW_WATER_SEMA already upped? */
+
 static void init_pool (struct pool *, void *base, size_t page_cnt,
                        const char *name);
 static bool page_from_pool (const struct pool *, void *page);
@@ -59,6 +75,11 @@ palloc_init (size_t user_page_limit)
   init_pool (&kernel_pool, free_start, kernel_pages, "kernel pool");
   init_pool (&user_pool, free_start + kernel_pages * PGSIZE,
              user_pages, "user pool");
+
+  /* Keep 1/32 of the user pool free, refilling to 1/16. */
+  low_water = DIV_ROUND_UP (user_pool.free_cnt, 32);
+  high_water = low_water * 2;
+  sema_init (&low_water_sema, 0);
 }
 
 /* Obtains and returns a group of PAGE_CNT contiguous free pages.
@@ -73,14 +94,29 @@ palloc_get_multiple (enum palloc_flags flags, size_t page_cnt)
   struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
   void *pages;
   size_t page_idx;
+  bool wake_pageout = false;
+  enum intr_level old_level;
 
   if (page_cnt == 0)
     return NULL;
 
   lock_acquire (&pool->lock);
-  page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
+  page_idx = bitmap_scan (pool->used_map, 0, page_cnt, false);
+  old_level = intr_disable ();
+  if (page_idx != BITMAP_ERROR)
+    {
+      bitmap_set_multiple (pool->used_map, page_idx, page_cnt, true);
+      pool->free_cnt -= page_cnt;
+    }
+  if (pool == &user_pool && pool->free_cnt < low_water
+      && !low_water_signaled)
+    wake_pageout = low_water_signaled = true;
+  intr_set_level (old_level);
   lock_release (&pool->lock);
 
+  if (wake_pageout)
+    sema_up (&low_water_sema);
+
   if (page_idx != BITMAP_ERROR)
     pages = pool->base + PGSIZE * page_idx;
   else
@@ -119,6 +155,7 @@ palloc_free_multiple (void *pages, size_t page_cnt)
 {
   struct pool *pool;
   size_t page_idx;
+  enum intr_level old_level;
 
   ASSERT (pg_ofs (pages) == 0);
   if (pages == NULL || page_cnt == 0)
@@ -137,8 +174,11 @@ palloc_free_multiple (void *pages, size_t page_cnt)
   memset (pages, 0xcc, PGSIZE * page_cnt);
 #endif
 
+  old_level = intr_disable ();
   ASSERT (bitmap_all (pool->used_map, page_idx, page_cnt));
   bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+  pool->free_cnt += page_cnt;
+  intr_set_level (old_level);
 }
 
 /* Frees the page at PAGE. */
@@ -148,6 +188,41 @@ palloc_free_page (void *page)
   palloc_free_multiple (page, 1);
 }
 
+/* Returns the number of free pages in the user pool. */
+size_t
+palloc_user_free_cnt (void)
+{
+  return user_pool.free_cnt;
+}
+
+/* Returns the total number of pages in the user pool. */
+size_t
+palloc_user_page_cnt (void)
+{
+  return bitmap_size (user_pool.used_map);
+}
+
+/* Returns true if the user pool has fewer free pages than its
+   high watermark, that is, if the page-out daemon should keep
+   evicting. */
+bool
+palloc_below_high_water (void)
+{
+  return user_pool.free_cnt < high_water;
+}
+
+/* Blocks until an allocation leaves the user pool below its low
+   watermark.  Called by the page-out daemon between batches. */
+void
+palloc_wait_low_water (void)
+{
+  enum intr_level old_level = intr_disable ();
+  low_water_signaled = false;
+  intr_set_level (old_level);
+
+  sema_down (&low_water_sema);
+}
+
 /* Initializes pool P as starting at START and ending at END,
    naming it NAME for debugging purposes. */
 static void
@@ -167,6 +242,7 @@ init_pool (struct pool *p, void *base, size_t page_cnt, const char *name)
   lock_init (&p->lock);
   p->used_map = bitmap_create_in_buf (page_cnt, base, bm_pages * PGSIZE);
   p->base = base + bm_pages * PGSIZE;
+  p->free_cnt = page_cnt;
 }
 
 /* Returns true if PAGE was allocated from POOL,
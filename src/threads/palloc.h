@@ -1,6 +1,7 @@
 #ifndef THREADS_PALLOC_H
 #define THREADS_PALLOC_H
 
+#include <stdbool.h>
 #include <stddef.h>
 
 /* How to allocate pages. */
@@ -17,4 +18,9 @@ void *palloc_get_multiple (enum palloc_flags, size_t page_cnt);
 void palloc_free_page (void *);
 void palloc_free_multiple (void *, size_t page_cnt);
 
+size_t palloc_user_free_cnt (void);
+size_t palloc_user_page_cnt (void);
+bool palloc_below_high_water (void);
+void palloc_wait_low_water (void);
+
 #endif /* threads/palloc.h */
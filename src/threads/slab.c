@@ -0,0 +1,211 @@
+#include "threads/slab.h"
+#include <debug.h>
+#include <list.h>
+#include <round.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* An object cache allocator, after Bonwick's slab allocator.
+
+   malloc() rounds every request up to a power of 2, which wastes
+   up to half of each block on kernel structures whose size is
+   not one, and serves all of them from a handful of shared free
+   lists.  A cache instead hands out objects of one exact size,
+   packed into pages called "slabs", each with its own free list,
+   under a lock of its own.
+
+   A cache may have a constructor, which is run once on each
+   object when its slab is created.  Objects must be freed in
+   their constructed state, so that state survives from one
+   allocation to the next and need not be set up again.  To make
+   that possible, the link that chains a free object into its
+   slab's free list is kept after the object rather than inside
+   it.
+
+   A slab with free objects is kept on its cache's list of
+   partial slabs.  A slab that becomes entirely free goes back to
+   the page allocator, unless it is the cache's only slab with
+   free objects. */
+
+/* Magic number for detecting slab corruption. */
+#define SLAB_MAGIC 0x51ab51ab
+
+/* Object cache. */
+struct kmem_cache
+  {
+    const char *name;           /* Name, for statistics. */
+    size_t obj_size;            /* Bytes per object as requested. */
+    size_t slot_size;           /* Bytes per object plus free link. */
+    size_t objs_per_slab;       /* Number of objects in a slab. */
+    void (*ctor) (void *);      /* Constructor, or null. */
+    struct list partial;        /* Slabs with free objects. */
+    struct lock lock;           /* Protects the slabs. */
+    size_t slab_cnt;            /* Slabs allocated. */
+    size_t obj_cnt;             /* Objects allocated. */
+    struct list_elem elem;      /* Element in cache_list. */
+  };
+
+/* Slab header, at the start of its page. */
+struct slab
+  {
+    unsigned magic;             /* Always set to SLAB_MAGIC. */
+    struct kmem_cache *cache;   /* Owning cache. */
+    size_t free_cnt;            /* Free objects. */
+    void *free;                 /* First free object. */
+    struct list_elem elem;      /* Element in partial list. */
+  };
+
+/* All caches, for statistics. */
+static struct list cache_list = LIST_INITIALIZER (cache_list);
+
+/* Returns the free list link of object OBJ in cache C. */
+static inline void **
+free_link (struct kmem_cache *c, void *obj)
+{
+  return (void **) ((uint8_t *) obj + c->slot_size - sizeof (void *));
+}
+
+/* Creates and returns a cache of SIZE-byte objects named NAME,
+   whose objects are set up by CTOR, if it is nonnull, when they
+   are created.  Panics if memory is not available. */
+struct kmem_cache *
+kmem_cache_create (const char *name, size_t size, void (*ctor) (void *))
+{
+  struct kmem_cache *c;
+
+  ASSERT (size > 0);
+
+  c = malloc (sizeof *c);
+  if (c == NULL)
+    PANIC ("kmem_cache_create: out of memory");
+  c->name = name;
+  c->obj_size = size;
+  c->slot_size = ROUND_UP (size, sizeof (void *)) + sizeof (void *);
+  c->objs_per_slab = (PGSIZE - sizeof (struct slab)) / c->slot_size;
+  ASSERT (c->objs_per_slab > 0);
+  c->ctor = ctor;
+  list_init (&c->partial);
+  lock_init (&c->lock);
+  c->slab_cnt = c->obj_cnt = 0;
+  list_push_back (&cache_list, &c->elem);
+  return c;
+}
+
+/* Allocates a new slab for cache C, constructs its objects and
+   adds it to C's partial list.  Returns false if memory is not
+   available.  C's lock must be held. */
+static bool
+slab_create (struct kmem_cache *c)
+{
+  struct slab *s;
+  size_t i;
+
+  s = palloc_get_page (0);
+  if (s == NULL)
+    return false;
+  s->magic = SLAB_MAGIC;
+  s->cache = c;
+  s->free_cnt = c->objs_per_slab;
+  s->free = NULL;
+  for (i = c->objs_per_slab; i-- > 0; )
+    {
+      void *obj = (uint8_t *) (s + 1) + i * c->slot_size;
+      if (c->ctor != NULL)
+        c->ctor (obj);
+      *free_link (c, obj) = s->free;
+      s->free = obj;
+    }
+  list_push_front (&c->partial, &s->elem);
+  c->slab_cnt++;
+  return true;
+}
+
+/* Returns the slab that object OBJ of cache C is in. */
+static struct slab *
+obj_to_slab (struct kmem_cache *c, void *obj)
+{
+  struct slab *s = pg_round_down (obj);
+
+  ASSERT (s->magic == SLAB_MAGIC);
+  ASSERT (s->cache == c);
+  ASSERT ((pg_ofs (obj) - sizeof *s) % c->slot_size == 0);
+  return s;
+}
+
+/* Obtains and returns an object from cache C.  Returns a null
+   pointer if memory is not available. */
+void *
+kmem_cache_alloc (struct kmem_cache *c)
+{
+  struct slab *s;
+  void *obj;
+
+  lock_acquire (&c->lock);
+  if (list_empty (&c->partial) && !slab_create (c))
+    {
+      lock_release (&c->lock);
+      return NULL;
+    }
+  s = list_entry (list_front (&c->partial), struct slab, elem);
+  obj = s->free;
+  s->free = *free_link (c, obj);
+  if (--s->free_cnt == 0)
+    list_remove (&s->elem);
+  c->obj_cnt++;
+  lock_release (&c->lock);
+  return obj;
+}
+
+/* Returns object OBJ, which must have come from
+   kmem_cache_alloc() on C, to C.  OBJ may be a null pointer. */
+void
+kmem_cache_free (struct kmem_cache *c, void *obj)
+{
+  struct slab *s;
+
+  if (obj == NULL)
+    return;
+  s = obj_to_slab (c, obj);
+
+#ifndef NDEBUG
+  /* Clear the object to help detect use-after-free bugs, unless
+     it has to keep its constructed state. */
+  if (c->ctor == NULL)
+    memset (obj, 0xcc, c->obj_size);
+#endif
+
+  lock_acquire (&c->lock);
+  *free_link (c, obj) = s->free;
+  s->free = obj;
+  c->obj_cnt--;
+  if (s->free_cnt++ == 0)
+    list_push_front (&c->partial, &s->elem);
+  else if (s->free_cnt == c->objs_per_slab
+           && list_front (&c->partial) != list_back (&c->partial))
+    {
+      list_remove (&s->elem);
+      c->slab_cnt--;
+      palloc_free_page (s);
+    }
+  lock_release (&c->lock);
+}
+
+/* Prints the number of objects and slabs of each cache. */
+void
+kmem_cache_print_stats (void)
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&cache_list); e != list_end (&cache_list);
+       e = list_next (e))
+    {
+      struct kmem_cache *c = list_entry (e, struct kmem_cache, elem);
+      printf ("Cache %s: %zu objects of %zu bytes in %zu slabs\n",
+              c->name, c->obj_cnt, c->obj_size, c->slab_cnt);
+    }
+}
@@ -27,10 +27,43 @@
 */
 
 #include "threads/synch.h"
+#include <inttypes.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/cpu.h"
 #include "threads/interrupt.h"
 #include "threads/thread.h"
+#include "threads/trace.h"
+
+/**pj3*****************************************************/
+/* Longest chain of lock holders that a priority is donated
+   along, in case of a deadlock or a very deep nesting. */
+#define DONATE_DEPTH 8
+
+/* Arrival order of waiters, so that threads of equal priority
+   are woken first come, first served. */
+static unsigned waiter_seq;
+
+/* Every lock class that has been used, most recent first. */
+static struct lock_class *lock_classes;
+
+/* Keep lock statistics? */
+bool lock_profile;
+
+/* Number of lock classes lock_print_stats() reports. */
+#define LOCK_REPORT_TOP 10
+
+static void class_register (struct lock_class *);
+static void class_count_acquire (struct lock_class *, bool contended,
+                                 uint64_t wait);
+static void class_count_hold (struct lock_class *, uint64_t since);
+static bool class_busier (const struct lock_class *,
+                          const struct lock_class *);
+static bool sema_less (const struct pheap_elem *,
+                       const struct pheap_elem *, void *);
+static bool cond_less (const struct pheap_elem *,
+                       const struct pheap_elem *, void *);
+/*********************************************************/
 
 /* Initializes semaphore SEMA to VALUE.  A semaphore is a
    nonnegative integer along with two atomic operators for
@@ -47,7 +80,7 @@ sema_init (struct semaphore *sema, unsigned value)
   ASSERT (sema != NULL);
 
   sema->value = value;
-  list_init (&sema->waiters);
+  pheap_init (&sema->waiters, sema_less, NULL);
 }
 
 /* Down or "P" operation on a semaphore.  Waits for SEMA's value
@@ -68,8 +101,18 @@ sema_down (struct semaphore *sema)
   old_level = intr_disable ();
   while (sema->value == 0) 
     {
-	  list_push_back (&sema->waiters, &thread_current()->elem);
+	  /**pj3****************************************************/
+	  struct thread *t = thread_current ();
+	  //unless cond_wait() keeps our place in a condition's
+	  //waiters, let set_priority() keep it here
+	  if (t->wait_heap == NULL){
+		t->wait_seq = waiter_seq++;
+		t->wait_heap = &sema->waiters;
+		t->wait_heap_elem = &t->wait_elem;
+	  }
+	  pheap_insert (&sema->waiters, &t->wait_elem);
 	  thread_block ();
+	  /*********************************************************/
     }
   sema->value--;
   intr_set_level (old_level);
@@ -115,22 +158,14 @@ sema_up (struct semaphore *sema)
   old_level = intr_disable ();
   /**pj3****************************************************/
   int flag = 0;
-  if (!list_empty (&sema->waiters)){
-	//find max_priority
-	struct thread *t = 0, *max_t;
-	struct list_elem *e_curr, *e_end;
-	e_curr = list_begin(&sema->waiters);
-	e_end = list_end(&sema->waiters);
-	max_t = list_entry(e_curr, struct thread, elem);
-	for(; e_curr != e_end; e_curr = list_next(e_curr)){
-	  t = list_entry(e_curr, struct thread, elem);
-	  if(t->priority > max_t->priority)
-		max_t = t;
-	}
-	//remove and unblock
-	list_remove(&max_t->elem);
-	thread_unblock(max_t);
-	if(thread_get_priority() < max_t->priority)
+  if (!pheap_empty (&sema->waiters)){
+	//the waiter with max_priority is at the front
+	struct thread *t = pheap_entry (pheap_pop_front (&sema->waiters),
+									struct thread, wait_elem);
+	if (t->wait_heap == &sema->waiters)
+	  t->wait_heap = NULL;
+	thread_unblock(t);
+	if(thread_get_priority() < t->priority)
 	  flag = 1;
   }
   sema->value++;
@@ -196,12 +231,16 @@ sema_test_helper (void *sema_)
    onerous, it's a good sign that a semaphore should be used,
    instead of a lock. */
 void
-lock_init (struct lock *lock)
+lock_init_class (struct lock *lock, struct lock_class *class)
 {
   ASSERT (lock != NULL);
 
   lock->holder = NULL;
   sema_init (&lock->semaphore, 1);
+  /**pj3****************************************************/
+  lock->class = class;
+  class_register (class);
+  /*********************************************************/
 }
 
 /* Acquires LOCK, sleeping until it becomes available if
@@ -219,8 +258,45 @@ lock_acquire (struct lock *lock)
   ASSERT (!intr_context ());
   ASSERT (!lock_held_by_current_thread (lock));
 
+  /**pj3****************************************************/
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
+  uint64_t start = 0;
+  bool contended;
+
+  old_level = intr_disable ();
+  contended = lock->holder != NULL;
+  if (lock_profile)
+	start = rdtsc ();
+  if (contended)
+	trace_event (TRACE_LOCK_WAIT, (uint32_t) lock, 0);
+  if (!thread_mlfqs && contended){
+	//donate our priority along the chain of holders: the
+	//holder of LOCK, the holder of the lock it waits for, ...
+	struct lock *l = lock;
+	int depth;
+
+	cur->wait_lock = lock;
+	for (depth = 0; depth < DONATE_DEPTH && l != NULL && l->holder != NULL;
+		 depth++){
+	  if (l->holder->priority >= cur->priority)
+		break;
+	  thread_donate_priority (l->holder, cur->priority);
+	  l = l->holder->wait_lock;
+	}
+  }
   sema_down (&lock->semaphore);
-  lock->holder = thread_current ();
+  if (contended)
+	trace_event (TRACE_LOCK_ACQUIRE, (uint32_t) lock, 0);
+  cur->wait_lock = NULL;
+  lock->holder = cur;
+  list_push_back (&cur->locks, &lock->elem);
+  if (lock_profile){
+	lock->acquired_at = rdtsc ();
+	class_count_acquire (lock->class, contended, lock->acquired_at - start);
+  }
+  intr_set_level (old_level);
+  /*********************************************************/
 }
 
 /* Tries to acquires LOCK and returns true if successful or false
@@ -239,7 +315,19 @@ lock_try_acquire (struct lock *lock)
 
   success = sema_try_down (&lock->semaphore);
   if (success)
-    lock->holder = thread_current ();
+    {
+      /**pj3****************************************************/
+      enum intr_level old_level = intr_disable ();
+      lock->holder = thread_current ();
+      list_push_back (&lock->holder->locks, &lock->elem);
+      if (lock_profile)
+        {
+          lock->acquired_at = rdtsc ();
+          class_count_acquire (lock->class, false, 0);
+        }
+      intr_set_level (old_level);
+      /*********************************************************/
+    }
   return success;
 }
 
@@ -254,8 +342,18 @@ lock_release (struct lock *lock)
   ASSERT (lock != NULL);
   ASSERT (lock_held_by_current_thread (lock));
 
+  /**pj3****************************************************/
+  enum intr_level old_level = intr_disable ();
+  if (lock_profile)
+	class_count_hold (lock->class, lock->acquired_at);
+  //drop the priority donated by the waiters for LOCK
+  list_remove (&lock->elem);
   lock->holder = NULL;
+  if (!thread_mlfqs)
+	thread_refresh_priority (thread_current ());
   sema_up (&lock->semaphore);
+  intr_set_level (old_level);
+  /*********************************************************/
 }
 
 /* Returns true if the current thread holds LOCK, false
@@ -269,13 +367,200 @@ lock_held_by_current_thread (const struct lock *lock)
   return lock->holder == thread_current ();
 }
 
+/**pj3*****************************************************/
+/* Returns the highest priority of the threads waiting for LOCK,
+   or PRI_MIN if there are none.  Interrupts must be off. */
+int
+lock_waiter_priority (struct lock *lock)
+{
+  struct pheap_elem *e = pheap_front (&lock->semaphore.waiters);
+
+  ASSERT (intr_get_level () == INTR_OFF);
+  return e != NULL ? pheap_entry (e, struct thread, wait_elem)->priority
+                   : PRI_MIN;
+}
+
+/* Initializes spinlock LOCK.  Use spinlock_init() instead, which
+   supplies CLASS. */
+void
+spinlock_init_class (struct spinlock *lock, struct lock_class *class)
+{
+  ASSERT (lock != NULL);
+
+  lock->locked = false;
+  lock->class = class;
+  class_register (class);
+}
+
+/* Acquires spinlock LOCK and turns interrupts off until it is
+   released.  The holder must not sleep. */
+void
+spin_lock (struct spinlock *lock)
+{
+  enum intr_level old_level;
+
+  ASSERT (lock != NULL);
+
+  old_level = intr_disable ();
+  //with interrupts off nothing else runs, so a held lock can only
+  //mean a recursive acquire or a holder that slept
+  if (__sync_lock_test_and_set (&lock->locked, true))
+	PANIC ("spinlock %s is already held", lock->class->name);
+  lock->old_level = old_level;
+  if (lock_profile){
+	lock->acquired_at = rdtsc ();
+	class_count_acquire (lock->class, false, 0);
+  }
+}
+
+/* Releases spinlock LOCK and restores the interrupt level from
+   before spin_lock(). */
+void
+spin_unlock (struct spinlock *lock)
+{
+  ASSERT (lock != NULL);
+  ASSERT (lock->locked);
+
+  if (lock_profile)
+	class_count_hold (lock->class, lock->acquired_at);
+  __sync_lock_release (&lock->locked);
+  intr_set_level (lock->old_level);
+}
+
+/* With -lockprof, prints the statistics of the LOCK_REPORT_TOP
+   lock classes that were waited for longest, or, among those
+   never waited for, held longest.  Short sections held under a
+   lock show up here as candidates for a spinlock. */
+void
+lock_print_stats (void)
+{
+  struct lock_class *top[LOCK_REPORT_TOP];
+  struct lock_class *c;
+  int cnt = 0, used = 0, i;
+
+  if (!lock_profile)
+    return;
+
+  //insertion sort into TOP, dropping what falls off the end
+  for (c = lock_classes; c != NULL; c = c->next){
+	if (c->acquires == 0)
+	  continue;
+	used++;
+	i = cnt < LOCK_REPORT_TOP ? cnt++ : LOCK_REPORT_TOP;
+	for (; i > 0 && class_busier (c, top[i - 1]); i--)
+	  if (i < LOCK_REPORT_TOP)
+		top[i] = top[i - 1];
+	if (i < LOCK_REPORT_TOP)
+	  top[i] = c;
+  }
+
+  printf ("Locks: top %d of %d lock classes, times in CPU cycles\n",
+          cnt, used);
+  for (i = 0; i < cnt; i++){
+	c = top[i];
+	printf ("Locks: %s%s at %s:%d: %u acquires, %u contended, "
+			"wait %"PRIu64" max %"PRIu64", hold %"PRIu64" max %"PRIu64"\n",
+			c->spin ? "spinlock " : "", c->name, c->file, c->line,
+			c->acquires, c->contended, c->wait_cycles, c->wait_max,
+			c->hold_cycles, c->hold_max);
+  }
+}
+
+/* Adds CLASS to lock_classes, unless it is there already. */
+static void
+class_register (struct lock_class *class)
+{
+  enum intr_level old_level;
+
+  ASSERT (class != NULL);
+
+  old_level = intr_disable ();
+  if (!class->registered){
+	class->registered = true;
+	class->next = lock_classes;
+	lock_classes = class;
+  }
+  intr_set_level (old_level);
+}
+
+/* Counts an acquire of a lock in CLASS, which was CONTENDED or
+   not, after waiting WAIT cycles.  Interrupts must be off. */
+static void
+class_count_acquire (struct lock_class *class, bool contended,
+                     uint64_t wait)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+  class->acquires++;
+  if (contended){
+	class->contended++;
+	class->wait_cycles += wait;
+	if (wait > class->wait_max)
+	  class->wait_max = wait;
+  }
+}
+
+/* Counts a hold of a lock in CLASS since cycle SINCE.
+   Interrupts must be off. */
+static void
+class_count_hold (struct lock_class *class, uint64_t since)
+{
+  uint64_t held = rdtsc () - since;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+  class->hold_cycles += held;
+  if (held > class->hold_max)
+	class->hold_max = held;
+}
+
+/* Returns true if lock class A ranks above B in
+   lock_print_stats(). */
+static bool
+class_busier (const struct lock_class *a, const struct lock_class *b)
+{
+  if (a->wait_cycles != b->wait_cycles)
+    return a->wait_cycles > b->wait_cycles;
+  return a->hold_cycles > b->hold_cycles;
+}
+
+/* Returns true if waiting thread A should be woken after B:
+   if it has lower priority, or equal priority and came later. */
+static bool
+waiter_less (const struct thread *a, const struct thread *b)
+{
+  if (a->priority != b->priority)
+    return a->priority < b->priority;
+  return (int) (a->wait_seq - b->wait_seq) > 0;
+}
+
+/* Orders the waiters of a semaphore. */
+static bool
+sema_less (const struct pheap_elem *a, const struct pheap_elem *b,
+           void *aux UNUSED)
+{
+  return waiter_less (pheap_entry (a, struct thread, wait_elem),
+                      pheap_entry (b, struct thread, wait_elem));
+}
+/*********************************************************/
+
 /* One semaphore in a list. */
 struct semaphore_elem 
   {
-    struct list_elem elem;              /* List element. */
+    struct pheap_elem elem;             /* Heap element. */
     struct semaphore semaphore;         /* This semaphore. */
+    struct thread *thread;              /* Thread waiting on it. */
   };
 
+/**pj3*****************************************************/
+/* Orders the waiters of a condition variable. */
+static bool
+cond_less (const struct pheap_elem *a, const struct pheap_elem *b,
+           void *aux UNUSED)
+{
+  return waiter_less (pheap_entry (a, struct semaphore_elem, elem)->thread,
+                      pheap_entry (b, struct semaphore_elem, elem)->thread);
+}
+/*********************************************************/
+
 /* Initializes condition variable COND.  A condition variable
    allows one piece of code to signal a condition and cooperating
    code to receive the signal and act upon it. */
@@ -284,7 +569,7 @@ cond_init (struct condition *cond)
 {
   ASSERT (cond != NULL);
 
-  list_init (&cond->waiters);
+  pheap_init (&cond->waiters, cond_less, NULL);
 }
 
 /* Atomically releases LOCK and waits for COND to be signaled by
@@ -318,7 +603,18 @@ cond_wait (struct condition *cond, struct lock *lock)
   ASSERT (lock_held_by_current_thread (lock));
   
   sema_init (&waiter.semaphore, 0);
-  list_push_back (&cond->waiters, &waiter.elem);
+  /**pj3****************************************************/
+  struct thread *cur = thread_current ();
+  enum intr_level old_level = intr_disable ();
+
+  //until signaled, set_priority() keeps our place in COND
+  waiter.thread = cur;
+  cur->wait_seq = waiter_seq++;
+  cur->wait_heap = &cond->waiters;
+  cur->wait_heap_elem = &waiter.elem;
+  pheap_insert (&cond->waiters, &waiter.elem);
+  intr_set_level (old_level);
+  /*********************************************************/
   lock_release (lock);
   sema_down (&waiter.semaphore);
   lock_acquire (lock);
@@ -339,9 +635,17 @@ cond_signal (struct condition *cond, struct lock *lock UNUSED)
   ASSERT (!intr_context ());
   ASSERT (lock_held_by_current_thread (lock));
 
-  if (!list_empty (&cond->waiters)) 
-    sema_up (&list_entry (list_pop_front (&cond->waiters),
-                          struct semaphore_elem, elem)->semaphore);
+  /**pj3****************************************************/
+  enum intr_level old_level = intr_disable ();
+  if (!pheap_empty (&cond->waiters)){
+	//wake the waiter with max_priority
+	struct semaphore_elem *w = pheap_entry (pheap_pop_front (&cond->waiters),
+											struct semaphore_elem, elem);
+	w->thread->wait_heap = NULL;
+	sema_up (&w->semaphore);
+  }
+  intr_set_level (old_level);
+  /*********************************************************/
 }
 
 /* Wakes up all threads, if any, waiting on COND (protected by
@@ -356,6 +660,6 @@ cond_broadcast (struct condition *cond, struct lock *lock)
   ASSERT (cond != NULL);
   ASSERT (lock != NULL);
 
-  while (!list_empty (&cond->waiters))
+  while (!pheap_empty (&cond->waiters))
     cond_signal (cond, lock);
 }
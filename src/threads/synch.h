@@ -2,13 +2,15 @@
 #define THREADS_SYNCH_H
 
 #include <list.h>
+#include <pheap.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 /* A counting semaphore. */
 struct semaphore 
   {
     unsigned value;             /* Current value. */
-    struct list waiters;        /* List of waiting threads. */
+    struct pheap waiters;       /* Waiting threads, by priority. */
   };
 
 void sema_init (struct semaphore *, unsigned value);
@@ -17,23 +19,79 @@ bool sema_try_down (struct semaphore *);
 void sema_up (struct semaphore *);
 void sema_self_test (void);
 
+/* Lock class.  Collects the statistics of all the locks that
+   are initialized at one place in the source, which outlives any
+   of the locks themselves.  Statistics are only kept if
+   lock_profile is set, by the kernel command-line option
+   "-lockprof". */
+struct lock_class
+  {
+    const char *name;           /* Lock as written at lock_init(). */
+    const char *file;           /* Source file of lock_init(). */
+    int line;                   /* Source line of lock_init(). */
+    bool spin;                  /* Spinlocks rather than locks? */
+    bool registered;            /* In the list of classes? */
+    unsigned acquires;          /* Times acquired. */
+    unsigned contended;         /* Times found already held. */
+    uint64_t wait_cycles;       /* Total CPU cycles waited. */
+    uint64_t wait_max;          /* Longest wait in CPU cycles. */
+    uint64_t hold_cycles;       /* Total CPU cycles held. */
+    uint64_t hold_max;          /* Longest hold in CPU cycles. */
+    struct lock_class *next;    /* Next class, see lock_print_stats(). */
+  };
+
+/* Defines a lock class for the call site and passes it to
+   INIT_FN along with LOCK. */
+#define LOCK_CLASS_INIT(INIT_FN, LOCK, SPIN)                    \
+        do {                                                    \
+          static struct lock_class lock_class_ =                \
+            { .name = #LOCK, .file = __FILE__,                  \
+              .line = __LINE__, .spin = SPIN };                 \
+          INIT_FN ((LOCK), &lock_class_);                       \
+        } while (0)
+
 /* Lock. */
 struct lock 
   {
     struct thread *holder;      /* Thread holding lock (for debugging). */
     struct semaphore semaphore; /* Binary semaphore controlling access. */
+    struct list_elem elem;      /* Element in holder's list of locks. */
+    struct lock_class *class;   /* Statistics. */
+    uint64_t acquired_at;       /* CPU cycle count when acquired. */
   };
 
-void lock_init (struct lock *);
+#define lock_init(LOCK) LOCK_CLASS_INIT (lock_init_class, LOCK, false)
+void lock_init_class (struct lock *, struct lock_class *);
 void lock_acquire (struct lock *);
 bool lock_try_acquire (struct lock *);
 void lock_release (struct lock *);
 bool lock_held_by_current_thread (const struct lock *);
+int lock_waiter_priority (struct lock *);
+void lock_print_stats (void);
+extern bool lock_profile;
+
+/* Spinlock, for short critical sections that never sleep.
+   Cheaper than a lock: it keeps no waiters and does not touch
+   the scheduler.  This is a uniprocessor, so a spinlock is held
+   with interrupts off, and it may be used in interrupt handlers
+   and with interrupts already off. */
+struct spinlock
+  {
+    bool locked;                /* Held? */
+    unsigned char old_level;    /* Interrupt level before acquiring. */
+    struct lock_class *class;   /* Statistics. */
+    uint64_t acquired_at;       /* CPU cycle count when acquired. */
+  };
+
+#define spinlock_init(LOCK) LOCK_CLASS_INIT (spinlock_init_class, LOCK, true)
+void spinlock_init_class (struct spinlock *, struct lock_class *);
+void spin_lock (struct spinlock *);
+void spin_unlock (struct spinlock *);
 
 /* Condition variable. */
 struct condition 
   {
-    struct list waiters;        /* List of waiting threads. */
+    struct pheap waiters;       /* Waiting threads, by priority. */
   };
 
 void cond_init (struct condition *);
@@ -5,7 +5,10 @@
 #include <stdio.h>
 #include <string.h>
 #include "threads/flags.h"
+#include "threads/cpu.h"
 #include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/trace.h"
 #include "threads/intr-stubs.h"
 #include "threads/palloc.h"
 #include "threads/switch.h"
@@ -20,6 +23,11 @@
 #ifndef USERPROG
 bool thread_prior_aging;
 #endif
+
+/* If true, prints the scheduler statistics of every thread when
+   it exits and at power off.  Controlled by kernel command-line
+   option "-schedstat". */
+bool thread_schedstat;
 /************************************************************/
 
 /* Random value for struct thread's `magic' member.
@@ -27,9 +35,21 @@ bool thread_prior_aging;
    of thread.h for details. */
 #define THREAD_MAGIC 0xcd6abf4b
 
-/* List of processes in THREAD_READY state, that is, processes
-   that are ready to run but not actually running. */
-struct list ready_list;
+/* Run queues of processes in THREAD_READY state, that is,
+   processes that are ready to run but not actually running: one
+   FIFO list per priority, and a bitmap with bit P set while
+   ready_queue[P] is not empty, so that enqueueing, dequeueing and
+   finding the highest priority ready thread take constant time
+   however many threads are ready. */
+static struct list ready_queue[PRI_MAX + 1];
+static uint64_t ready_mask;
+static int ready_cnt;           /* Threads in the run queues. */
+
+/* Priority aging advances every ready thread by one priority per
+   tick.  That is done by moving each run queue up one place; a
+   thread's own priority is brought up to date with
+   age_apply() when it leaves its queue. */
+static unsigned age_ticks;      /* Ticks of aging so far. */
 
 /* List of all processes.  Processes are added to this list
    when they are first scheduled and removed when they exit. */
@@ -38,11 +58,25 @@ struct list all_list;
 /* Idle thread. */
 struct thread *idle_thread;
 
+/**pj3*******************************************************/
+/* With -mlfqs, recomputes recent_cpu and priority of every
+   thread once a second.  The timer interrupt only wakes it, so
+   the pass runs after the interrupt has returned. */
+static struct thread *mlfqs_thread;
+
+/* The pass visits this many threads at a time with interrupts
+   off.  In between it turns them back on, leaving its place in
+   all_list in mlfqs_cursor, which thread_exit() moves past a
+   thread that leaves the list. */
+#define MLFQS_BATCH 16
+static struct list_elem *mlfqs_cursor;
+/************************************************************/
+
 /* Initial thread, the thread running init.c:main(). */
 static struct thread *initial_thread;
 
 /* Lock used by allocate_tid(). */
-static struct lock tid_lock;
+static struct spinlock tid_lock;
 
 /* Stack frame for kernel_thread(). */
 struct kernel_thread_frame 
@@ -69,6 +103,7 @@ bool thread_mlfqs;
 static void kernel_thread (thread_func *, void *aux);
 
 static void idle (void *aux UNUSED);
+static void mlfqs_update (void *aux UNUSED);
 static struct thread *running_thread (void);
 static struct thread *next_thread_to_run (void);
 static void init_thread (struct thread *, const char *name, int priority);
@@ -77,6 +112,12 @@ static void *alloc_frame (struct thread *, size_t size);
 static void schedule (void);
 void thread_schedule_tail (struct thread *prev);
 static tid_t allocate_tid (void);
+static void rq_push (struct thread *);
+static void rq_remove (struct thread *);
+static struct thread *rq_pop (void);
+static void set_priority (struct thread *, int priority);
+static void sched_account (struct thread *);
+static void sched_print (struct thread *, const struct schedstat *);
 
 /* Initializes the threading system by transforming the code
    that's currently running into a thread.  This can't work in
@@ -95,13 +136,17 @@ void
 thread_init (void) 
 {
   ASSERT (intr_get_level () == INTR_OFF);
-  lock_init (&tid_lock);
-  list_init (&ready_list);
+  int p;
+
+  ASSERT (PRI_MAX - PRI_MIN < 64);
+
+  spinlock_init (&tid_lock);
+  for (p = PRI_MIN; p <= PRI_MAX; p++)
+    list_init (&ready_queue[p]);
   list_init (&all_list);
 
   /**pj3**************************************************/
   //initailization
-  list_init (&sleep_list);
   load_avg = 0;
   /*******************************************************/
   
@@ -129,6 +174,11 @@ thread_start (void)
   /* Create the idle thread. */
   struct semaphore idle_started;
   sema_init (&idle_started, 0);
+
+  /**pj3**************************************************/
+  //malloc() works from here on
+  initial_thread->stats = calloc (1, sizeof *initial_thread->stats);
+  /*******************************************************/
   thread_create ("idle", PRI_MIN, idle, &idle_started);
 
   /* Start preemptive thread scheduling. */
@@ -136,6 +186,9 @@ thread_start (void)
 
   /* Wait for the idle thread to initialize idle_thread. */
   sema_down (&idle_started);
+
+  if (thread_mlfqs)
+    thread_create ("mlfqs", PRI_MAX, mlfqs_update, NULL);
 }
 
 /* Called by the timer interrupt handler at each timer tick.
@@ -158,21 +211,29 @@ thread_tick (void)
   /* Enforce preemption. */
 /**pj3******************************************************/
   if (thread_mlfqs){
-	if(t != idle_thread)
+	bool busy = t != idle_thread && t != mlfqs_thread;
+	if(busy)
       t->recent_cpu += FSHIFT;
 	//every second
     if (timer_ticks() % TIMER_FREQ == 0){
-      int ready_threads = list_size(&ready_list);
-      if (t != idle_thread)
+      int ready_threads = ready_cnt;
+      if (busy)
         ready_threads += 1;
-	  //recalculate load_avg, recent_cpu
+	  //mlfqs_thread is not counted, like idle_thread, even when a
+	  //pass of it was preempted and is still waiting to finish
+	  if (mlfqs_thread != NULL && mlfqs_thread->status == THREAD_READY)
+		ready_threads -= 1;
+	  //recalculate load_avg, and let mlfqs_thread do recent_cpu
       load_avg = (59 * load_avg + ready_threads * FSHIFT) / 60;
-	  thread_foreach(recpu_update, 0);
+	  if (mlfqs_thread != NULL && mlfqs_thread->status == THREAD_BLOCKED)
+		thread_unblock (mlfqs_thread);
+	  intr_yield_on_return();
     }
 	//every time slice(4 ticks)
     if (timer_ticks() % TIME_SLICE == 0){
-	  //recalculate priority
-	  thread_foreach(pri_update, 0);
+	  //only the running thread's recent_cpu changed since its
+	  //priority was last computed, see schedule()
+	  pri_update(t, 0);
 	  intr_yield_on_return();
     }
   }
@@ -181,28 +242,90 @@ thread_tick (void)
 	  intr_yield_on_return();
 #ifndef USERPROG
     if (thread_prior_aging){
-	  //all priority in ready_list + 1
-	  struct list_elem *e_curr, *e_end;
-	  e_curr = list_begin(&ready_list);
-	  e_end = list_end(&ready_list);
-	  for(; e_curr != e_end; e_curr = list_next(e_curr)){
-		t = list_entry(e_curr, struct thread, elem);
-		t->priority++;
-	  }
+	  //all priority in run queues + 1: move every queue up one
+	  int p;
+	  age_ticks++;
+	  for (p = PRI_MAX - 1; p >= PRI_MIN; p--)
+		if (ready_mask & (uint64_t) 1 << p)
+		  list_splice (list_end (&ready_queue[p + 1]),
+					   list_begin (&ready_queue[p]),
+					   list_end (&ready_queue[p]));
+	  ready_mask = ready_mask << 1 | (ready_mask & (uint64_t) 1 << PRI_MAX);
 	}
 #endif
   }
   /***********************************************************/
 }
 
+/* Accounts for CNT timer ticks that the timer skipped while the
+   CPU was idle.  Runs in the timer interrupt. */
+void
+thread_idle_ticks (int64_t cnt) 
+{
+  idle_ticks += cnt;
+}
+
+/* Returns true if the CPU has nothing to do: the running thread
+   is the idle thread and no thread is ready. */
+bool
+thread_cpu_idle (void) 
+{
+  return running_thread () == idle_thread && ready_cnt == 0;
+}
+
 /* Prints thread statistics. */
 void
 thread_print_stats (void) 
 {
   printf ("Thread: %lld idle ticks, %lld kernel ticks, %lld user ticks\n",
           idle_ticks, kernel_ticks, user_ticks);
+  /**pj3****************************************************/
+  if (thread_schedstat){
+	struct list_elem *e;
+	for (e = list_begin (&all_list); e != list_end (&all_list);
+		 e = list_next (e))
+	  {
+		struct thread *t = list_entry (e, struct thread, allelem);
+		if (t->stats != NULL)
+		  sched_print (t, &t->stats->sched);
+	  }
+  }
+  /*********************************************************/
 }
 
+/**pj3*******************************************************/
+/* Stores the scheduler statistics of the thread with TID, or of
+   the running thread if TID is SCHEDSTAT_SELF, in *ST, up to
+   date to now.  Returns false if there is no such thread. */
+bool
+thread_get_schedstat (tid_t tid, struct schedstat *st) 
+{
+  enum intr_level old_level = intr_disable ();
+  struct thread *t = NULL;
+  struct list_elem *e;
+
+  if (tid == SCHEDSTAT_SELF)
+    t = thread_current ();
+  else
+    for (e = list_begin (&all_list); e != list_end (&all_list);
+         e = list_next (e))
+      if (list_entry (e, struct thread, allelem)->tid == tid)
+        {
+          t = list_entry (e, struct thread, allelem);
+          break;
+        }
+  if (t != NULL && t->stats != NULL)
+    {
+      sched_account (t);
+      *st = t->stats->sched;
+    }
+  else
+    t = NULL;
+  intr_set_level (old_level);
+  return t != NULL;
+}
+/************************************************************/
+
 /* Creates a new kernel thread named NAME with the given initial
    PRIORITY, which executes FUNCTION passing AUX as the argument,
    and adds it to the ready queue.  Returns the thread identifier
@@ -226,17 +349,25 @@ thread_create (const char *name, int priority,
   struct kernel_thread_frame *kf;
   struct switch_entry_frame *ef;
   struct switch_threads_frame *sf;
+  struct thread_stats *stats;
   tid_t tid;
 
   ASSERT (function != NULL);
 
   /* Allocate thread. */
+  stats = calloc (1, sizeof *stats);
+  if (stats == NULL)
+    return TID_ERROR;
   t = palloc_get_page (PAL_ZERO);
   if (t == NULL)
-    return TID_ERROR;
+    {
+      free (stats);
+      return TID_ERROR;
+    }
 
   /* Initialize thread. */
   init_thread (t, name, priority);
+  t->stats = stats;
   tid = t->tid = allocate_tid ();
   if(thread_current()->t_dir)
 	t->t_dir = dir_reopen(thread_current()->t_dir);
@@ -274,6 +405,7 @@ thread_block (void)
   ASSERT (!intr_context ());
   ASSERT (intr_get_level () == INTR_OFF);
 
+  sched_account (thread_current ());
   thread_current ()->status = THREAD_BLOCKED;
   schedule ();
 }
@@ -295,7 +427,9 @@ thread_unblock (struct thread *t)
 
   old_level = intr_disable ();
   ASSERT (t->status == THREAD_BLOCKED);
-  list_insert_ordered(&ready_list, &t->elem, p_cmp, 0);
+  rq_push (t);
+  sched_account (t);
+  t->woken_at = t->state_since;
   t->status = THREAD_READY;
   intr_set_level (old_level);
 }
@@ -344,10 +478,28 @@ thread_exit (void)
   process_exit ();
 #endif
 
+  /**pj3****************************************************/
+  {
+	struct thread *cur = thread_current ();
+	enum intr_level old_level = intr_disable ();
+	struct thread_stats *stats;
+
+	sched_account (cur);
+	stats = cur->stats;
+	cur->stats = NULL;
+	intr_set_level (old_level);
+	if (thread_schedstat && stats != NULL)
+	  sched_print (cur, &stats->sched);
+	free (stats);
+  }
+  /*********************************************************/
+
   /* Remove thread from all threads list, set our status to dying,
      and schedule another process.  That process will destroy us
      when it calls thread_schedule_tail(). */
   intr_disable ();
+  if (mlfqs_cursor == &thread_current ()->allelem)
+    mlfqs_cursor = list_next (mlfqs_cursor);
   list_remove (&thread_current()->allelem);
   thread_current ()->status = THREAD_DYING;
   schedule ();
@@ -366,8 +518,8 @@ thread_yield (void)
 
   old_level = intr_disable ();
   if (cur != idle_thread) 
-	//ready_list ordered
-	list_insert_ordered(&ready_list, &cur->elem, p_cmp, 0);	
+	rq_push (cur);
+  sched_account (cur);
   cur->status = THREAD_READY;
   schedule ();
   intr_set_level (old_level);
@@ -395,9 +547,15 @@ void
 thread_set_priority (int new_priority) 
 {
   if(thread_mlfqs) return;
-  int old_priority = thread_get_priority();
-  thread_current ()->priority = new_priority;
-  if(new_priority < old_priority)
+  struct thread *cur = thread_current ();
+  int old_priority = cur->priority;
+  enum intr_level old_level = intr_disable ();
+
+  //donations stay in effect above the new base priority
+  cur->base_priority = new_priority;
+  thread_refresh_priority (cur);
+  intr_set_level (old_level);
+  if(cur->priority < old_priority)
 	thread_yield();  
 }
 
@@ -465,6 +623,9 @@ idle (void *idle_started_ UNUSED)
       intr_disable ();
       thread_block ();
 
+      /* Stop the timer tick until the next timer event. */
+      timer_idle ();
+
       /* Re-enable interrupts and wait for the next one.
 
          The `sti' instruction disables interrupts until the
@@ -481,6 +642,43 @@ idle (void *idle_started_ UNUSED)
     }
 }
 
+/* MLFQS thread.  Sleeps until the timer interrupt wakes it at
+   the start of each second, then recomputes recent_cpu and
+   priority of every thread, outside the interrupt handler.
+   all_list requires interrupts off, so it walks the list in
+   batches of MLFQS_BATCH threads and lets interrupts in between
+   them. */
+static void
+mlfqs_update (void *aux UNUSED) 
+{
+  mlfqs_thread = thread_current ();
+
+  for (;;) 
+    {
+      int n = 0;
+
+      intr_disable ();
+      thread_block ();
+      mlfqs_cursor = list_begin (&all_list);
+      while (mlfqs_cursor != list_end (&all_list))
+        {
+          struct thread *t = list_entry (mlfqs_cursor, struct thread,
+                                         allelem);
+
+          mlfqs_cursor = list_next (mlfqs_cursor);
+          recpu_update (t, NULL);
+          pri_update (t, NULL);
+          if (++n % MLFQS_BATCH == 0)
+            {
+              intr_enable ();
+              intr_disable ();
+            }
+        }
+      mlfqs_cursor = NULL;
+      intr_enable ();
+    }
+}
+
 /* Function used as the basis for a kernel thread. */
 static void
 kernel_thread (thread_func *function, void *aux) 
@@ -529,6 +727,9 @@ init_thread (struct thread *t, const char *name, int priority)
   strlcpy (t->name, name, sizeof t->name);
   t->stack = (uint8_t *) t + PGSIZE;
   t->priority = priority;
+  t->base_priority = priority;
+  t->state_since = rdtsc ();
+  list_init (&t->locks);
   t->magic = THREAD_MAGIC;
 
   old_level = intr_disable ();
@@ -581,10 +782,86 @@ alloc_frame (struct thread *t, size_t size)
 static struct thread *
 next_thread_to_run (void) 
 {
-  if (list_empty (&ready_list))
+  if (ready_mask == 0)
     return idle_thread;
   else
-    return list_entry (list_pop_front (&ready_list), struct thread, elem);
+    return rq_pop ();
+}
+
+/* Brings the priority of ready thread T up to date with the
+   aging it has received since it was made ready. */
+static void
+age_apply (struct thread *t)
+{
+  unsigned age = age_ticks - t->age_stamp;
+
+  /* A waiter that was made ready before it blocked is still
+     keyed by its priority in the heap it waits in. */
+  if (t->wait_heap != NULL)
+    pheap_remove (t->wait_heap, t->wait_heap_elem);
+  t->priority = (unsigned) (PRI_MAX - t->priority) > age
+                ? t->priority + (int) age : PRI_MAX;
+  t->base_priority = (unsigned) (PRI_MAX - t->base_priority) > age
+                     ? t->base_priority + (int) age : PRI_MAX;
+  t->age_stamp = age_ticks;
+  if (t->wait_heap != NULL)
+    pheap_insert (t->wait_heap, t->wait_heap_elem);
+}
+
+/* Adds T to the back of the run queue for its priority. */
+static void
+rq_push (struct thread *t)
+{
+  list_push_back (&ready_queue[t->priority], &t->elem);
+  ready_mask |= (uint64_t) 1 << t->priority;
+  ready_cnt++;
+  t->age_stamp = age_ticks;
+}
+
+/* Removes ready thread T from its run queue. */
+static void
+rq_remove (struct thread *t)
+{
+  age_apply (t);
+  list_remove (&t->elem);
+  if (list_empty (&ready_queue[t->priority]))
+    ready_mask &= ~((uint64_t) 1 << t->priority);
+  ready_cnt--;
+}
+
+/* Removes and returns the thread at the front of the highest
+   priority nonempty run queue, which must exist. */
+static struct thread *
+rq_pop (void)
+{
+  uint32_t hi = ready_mask >> 32;
+  int p = hi != 0 ? 63 - __builtin_clz (hi)
+                  : 31 - __builtin_clz ((uint32_t) ready_mask);
+  struct thread *t = list_entry (list_front (&ready_queue[p]),
+                                 struct thread, elem);
+
+  rq_remove (t);
+  return t;
+}
+
+/* Sets the priority of T to PRIORITY, moving it to the matching
+   run queue if it is ready and re-keying it among the waiters it
+   is queued with, if any.  A thread can be both, between being
+   queued by cond_wait() and blocking. */
+static void
+set_priority (struct thread *t, int priority)
+{
+  bool ready = t->status == THREAD_READY && t != idle_thread;
+
+  if (ready)
+    rq_remove (t);
+  if (t->wait_heap != NULL)
+    pheap_remove (t->wait_heap, t->wait_heap_elem);
+  t->priority = priority;
+  if (t->wait_heap != NULL)
+    pheap_insert (t->wait_heap, t->wait_heap_elem);
+  if (ready)
+    rq_push (t);
 }
 
 /* Completes a thread switch by activating the new thread's page
@@ -610,7 +887,23 @@ thread_schedule_tail (struct thread *prev)
   
   ASSERT (intr_get_level () == INTR_OFF);
 
-  /* Mark us as running. */
+  /* Mark us as running, counting the time since we were made
+     ready, and since we were woken up if we were blocked. */
+  sched_account (cur);
+  if (cur->woken_at != 0)
+    {
+      uint64_t lat = (cur->state_since - cur->woken_at)
+                     >> SCHEDSTAT_LAT_SHIFT;
+      int b = 0;
+      while (lat > 1 && b < SCHEDSTAT_LAT_BUCKETS - 1)
+        {
+          lat >>= 1;
+          b++;
+        }
+      if (cur->stats != NULL)
+        cur->stats->sched.latency[b]++;
+      cur->woken_at = 0;
+    }
   cur->status = THREAD_RUNNING;
 
   /* Start new time slice. */
@@ -644,18 +937,77 @@ static void
 schedule (void) 
 {
   struct thread *cur = running_thread ();
-  struct thread *next = next_thread_to_run ();
+  struct thread *next;
   struct thread *prev = NULL;
 
   ASSERT (intr_get_level () == INTR_OFF);
   ASSERT (cur->status != THREAD_RUNNING);
+
+  /* Bring the priority of a thread that stops running in the
+     middle of a time slice up to date with its recent_cpu, so
+     that thread_tick() need only update the running thread. */
+  if (thread_mlfqs && cur->status != THREAD_DYING)
+    pri_update (cur, NULL);
+  next = next_thread_to_run ();
   ASSERT (is_thread (next));
 
+  /* The timer may be skipping ticks for the idle thread. */
+  if (cur == idle_thread && next != idle_thread)
+    timer_idle_exit ();
+
   if (cur != next)
-    prev = switch_threads (cur, next);
+    {
+      if (cur->stats == NULL)
+        ;
+      else if (cur->status == THREAD_READY)
+        cur->stats->sched.involuntary++;
+      else
+        cur->stats->sched.voluntary++;
+      trace_event (TRACE_SWITCH, next->tid, cur->status);
+      prev = switch_threads (cur, next);
+    }
   thread_schedule_tail (prev);
 }
 
+/* Charges running, ready or blocked thread T for the time since
+   its status last changed, and starts timing its next status.
+   Interrupts must be off. */
+static void
+sched_account (struct thread *t)
+{
+  uint64_t now = rdtsc ();
+  long long d = now - t->state_since;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+  t->state_since = now;
+  if (t->stats == NULL)
+    return;
+  if (t->status == THREAD_RUNNING)
+    t->stats->sched.run_time += d;
+  else if (t->status == THREAD_READY)
+    t->stats->sched.ready_time += d;
+  else if (t->status == THREAD_BLOCKED)
+    t->stats->sched.blocked_time += d;
+}
+
+/* Prints the scheduler statistics ST of T, as of its last
+   status change. */
+static void
+sched_print (struct thread *t, const struct schedstat *st)
+{
+  int b;
+
+  printf ("Sched: %s (tid %d): %lld run, %lld ready, %lld blocked cycles, "
+          "%u voluntary, %u involuntary switches\n",
+          t->name, t->tid, st->run_time, st->ready_time, st->blocked_time,
+          st->voluntary, st->involuntary);
+  printf ("Sched: %s (tid %d): wakeup latency", t->name, t->tid);
+  for (b = 0; b < SCHEDSTAT_LAT_BUCKETS; b++)
+    if (st->latency[b] != 0)
+      printf (" 2^%d:%u", b + SCHEDSTAT_LAT_SHIFT, st->latency[b]);
+  printf ("\n");
+}
+
 /* Returns a tid to use for a new thread. */
 static tid_t
 allocate_tid (void) 
@@ -663,9 +1015,9 @@ allocate_tid (void)
   static tid_t next_tid = 1;
   tid_t tid;
 
-  lock_acquire (&tid_lock);
+  spin_lock (&tid_lock);
   tid = next_tid++;
-  lock_release (&tid_lock);
+  spin_unlock (&tid_lock);
 
   return tid;
 }
@@ -701,11 +1053,37 @@ int f2pri(int a){
 }
 
 void pri_update(struct thread *t, void *aux UNUSED){
-  t->priority = f2pri(PRI_MAX * FSHIFT - t->recent_cpu / 4 - t->nice * FSHIFT * 2);
+  if (t == idle_thread || t == mlfqs_thread)
+	return;
+  set_priority(t, f2pri(PRI_MAX * FSHIFT - t->recent_cpu / 4 - t->nice * FSHIFT * 2));
+}
+
+/* Raises T's priority to PRIORITY, donated by a thread waiting
+   for a lock that T holds.  Interrupts must be off. */
+void thread_donate_priority(struct thread *t, int priority){
+  ASSERT (intr_get_level () == INTR_OFF);
+  if (t->priority < priority)
+	set_priority(t, priority);
+}
+
+/* Recomputes T's priority as the highest of its base priority
+   and the priorities of the threads waiting for the locks it
+   holds.  Interrupts must be off. */
+void thread_refresh_priority(struct thread *t){
+  int priority = t->base_priority;
+  struct list_elem *e;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+  for (e = list_begin (&t->locks); e != list_end (&t->locks); e = list_next (e)){
+	int p = lock_waiter_priority (list_entry (e, struct lock, elem));
+	if (p > priority)
+	  priority = p;
+  }
+  set_priority(t, priority);
 }
 
 void recpu_update(struct thread *t, void *aux UNUSED){
-  if (t != idle_thread)
+  if (t != idle_thread && t != mlfqs_thread)
 	t->recent_cpu = f_mul(f_div(2 * load_avg, 2 * load_avg + FSHIFT), t->recent_cpu) + t->nice * FSHIFT;
 }
 /***********************************************************/
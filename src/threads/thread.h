@@ -6,12 +6,15 @@
 #include <stdint.h>
 #include "synch.h"
 #include <hash.h>
+#include "vm/page.h"
+#include <vmstat.h>
+#include <schedstat.h>
 
 /**pj3******************************************************/
 #define FSHIFT (1 << 14)
-struct list sleep_list;
 int load_avg;
 extern bool thread_prior_aging;
+extern bool thread_schedstat;
 unsigned thread_ticks;
 /***********************************************************/
 
@@ -34,6 +37,18 @@ typedef int tid_t;
 #define PRI_DEFAULT 31                  /* Default priority. */
 #define PRI_MAX 63                      /* Highest priority. */
 
+/**pj3*******************************************************/
+/* Counters of a thread that only schedstat(), vmstat() and the
+   statistics printouts read.  They are allocated apart from
+   struct thread so as not to take room from the kernel stack
+   that shares its page. */
+struct thread_stats
+  {
+    struct schedstat sched;             /* Scheduler statistics. */
+    struct vmstat vm;                   /* VM counters, see vm/frame.h. */
+  };
+/************************************************************/
+
 /* A kernel thread or user process.
 
    Each thread structure is stored in its own 4 kB page.  The
@@ -84,12 +99,10 @@ typedef int tid_t;
    the `magic' member of the running thread's `struct thread' is
    set to THREAD_MAGIC.  Stack overflow will normally change this
    value, triggering the assertion. */
-/* The `elem' member has a dual purpose.  It can be an element in
-   the run queue (thread.c), or it can be an element in a
-   semaphore wait list (synch.c).  It can be used these two ways
-   only because they are mutually exclusive: only a thread in the
-   ready state is on the run queue, whereas only a thread in the
-   blocked state is on a semaphore wait list. */
+/* The `elem' member is an element in the run queue (thread.c).
+   Only a thread in the ready state is on the run queue.  A
+   thread waiting for a semaphore is in the semaphore's waiter
+   heap through `wait_elem' instead (synch.c). */
 struct thread
   {
     /* Owned by thread.c. */
@@ -104,11 +117,27 @@ struct thread
     struct list_elem elem;              /* List element. */
 
 /**pj3******************************************************/
-	int tick;
+	int64_t wake;                       /* Wake-up time, see devices/timer.c. */
 	int recent_cpu;
 	int nice;
+	unsigned age_stamp;                 /* age_ticks when made ready. */
+	int base_priority;                  /* Priority before donations. */
+	struct list locks;                  /* Locks held, see synch.c. */
+	struct lock *wait_lock;             /* Lock being waited for. */
+	struct pheap_elem wait_elem;        /* Element in a semaphore's waiters. */
+	struct pheap *wait_heap;            /* Waiter heap ordered on priority. */
+	struct pheap_elem *wait_heap_elem;  /* Our element in wait_heap. */
+	unsigned wait_seq;                  /* Arrival order in wait_heap. */
+	struct thread_stats *stats;         /* Null before malloc_init() or
+	                                       once the thread exits. */
+	uint64_t state_since;               /* Time of last status change. */
+	uint64_t woken_at;                  /* Time of unblock, 0 if none. */
 /**pj4******************************************************/
-	struct hash spt;
+	struct spt spt;
+	int rss;                            /* Frames mapped, see vm/frame.c. */
+	int wss;                            /* Working set estimate. */
+	int ws_ref;                         /* Referenced frames this sweep. */
+	struct stack_region ustack;         /* User stack, see vm/page.c. */
 /**pj5******************************************************/
 	struct dir *t_dir;
 /***********************************************************/
@@ -130,6 +159,9 @@ struct thread
 	int flag;
 	struct thread *pa;
 	struct semaphore l_sema;
+/**pj4******************************************************/
+	void *user_esp;                     /* User esp at system call entry. */
+	void *io_buf;                       /* Bounce page for read and write. */
 /***********************************************************/
 #endif
 
@@ -146,7 +178,10 @@ void thread_init (void);
 void thread_start (void);
 
 void thread_tick (void);
+void thread_idle_ticks (int64_t cnt);
+bool thread_cpu_idle (void);
 void thread_print_stats (void);
+bool thread_get_schedstat (tid_t, struct schedstat *);
 
 typedef void thread_func (void *aux);
 tid_t thread_create (const char *name, int priority, thread_func *, void *);
@@ -179,6 +214,8 @@ int f_mul(int a, int b);
 int f_div(int a, int b);
 int f2pri(int a);
 void pri_update(struct thread *t, void *aux);
+void thread_donate_priority(struct thread *t, int priority);
+void thread_refresh_priority(struct thread *t);
 void recpu_update(struct thread *t, void *aux);
 /************************************************************/
 #endif /* threads/thread.h */
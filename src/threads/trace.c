@@ -0,0 +1,137 @@
+#include "threads/trace.h"
+#include <debug.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/block.h"
+#include "devices/timer.h"
+#include "threads/cpu.h"
+#include "threads/palloc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+
+/* Size of the ring buffer: 64 pages of 16-byte records. */
+#define TRACE_PAGES 64
+#define TRACE_RECS (TRACE_PAGES * PGSIZE / sizeof (struct trace_rec))
+
+/* Records per sector of a dump. */
+#define RECS_PER_SECTOR (BLOCK_SECTOR_SIZE / sizeof (struct trace_rec))
+
+/* Record events? */
+bool trace_enabled;
+
+/* The ring buffer.  trace_head counts the records ever claimed;
+   record I goes to trace_buf[I % TRACE_RECS]. */
+static struct trace_rec *trace_buf;
+static uint32_t trace_head;
+
+/* Time stamp and timer tick when tracing began, to measure the
+   time stamp rate. */
+static uint64_t start_tsc;
+static int64_t start_ticks;
+
+static uint16_t current_tid (void);
+
+/* Allocates the ring buffer and starts tracing.  Called at boot
+   if "-trace" was given; must follow timer_calibrate(). */
+void
+trace_init (void) 
+{
+  ASSERT (TRACE_RECS % RECS_PER_SECTOR == 0);
+
+  trace_buf = palloc_get_multiple (PAL_ZERO, TRACE_PAGES);
+  if (trace_buf == NULL)
+    {
+      printf ("Trace: no memory for the trace buffer, not tracing\n");
+      return;
+    }
+  start_ticks = timer_ticks ();
+  start_tsc = rdtsc ();
+  trace_enabled = true;
+}
+
+/* Records an event of TYPE with arguments ARG and AUX.  Use
+   trace_event() instead, which checks trace_enabled first.
+
+   Claiming a slot is a single atomic add, so an interrupt handler
+   that records an event in the middle of this function just takes
+   the next slot. */
+void
+trace_record (enum trace_type type, uint32_t arg, uint8_t aux) 
+{
+  uint32_t i = __sync_fetch_and_add (&trace_head, 1);
+  struct trace_rec *r = &trace_buf[i % TRACE_RECS];
+
+  r->tsc = rdtsc ();
+  r->arg = arg;
+  r->tid = current_tid ();
+  r->type = type;
+  r->aux = aux;
+}
+
+/* Stops tracing and writes the buffered events to the scratch
+   block device.  Does nothing if tracing is off. */
+void
+trace_dump (void) 
+{
+  static struct trace_rec sector[RECS_PER_SECTOR];
+  struct trace_header *h = (struct trace_header *) sector;
+  struct block *scratch;
+  uint32_t head, cnt, first, i;
+  block_sector_t s;
+  int64_t ticks;
+
+  if (!trace_enabled)
+    return;
+  trace_enabled = false;
+  head = trace_head;
+
+  scratch = block_get_role (BLOCK_SCRATCH);
+  if (scratch == NULL)
+    {
+      printf ("Trace: no scratch device, %"PRIu32" events dropped\n", head);
+      return;
+    }
+
+  /* Keep the newest events that fit both the buffer and the
+     device. */
+  cnt = head < TRACE_RECS ? head : TRACE_RECS;
+  if (cnt > (block_size (scratch) - 1) * RECS_PER_SECTOR)
+    cnt = (block_size (scratch) - 1) * RECS_PER_SECTOR;
+  first = head - cnt;
+
+  memset (sector, 0, sizeof sector);
+  h->magic = TRACE_MAGIC;
+  h->version = TRACE_VERSION;
+  h->rec_cnt = cnt;
+  h->lost = first;
+  h->tsc_start = start_tsc;
+  ticks = timer_ticks () - start_ticks;
+  h->tsc_hz = ticks > 0 ? (rdtsc () - start_tsc) * TIMER_FREQ / ticks : 0;
+  block_write (scratch, 0, sector);
+
+  for (i = 0, s = 1; i < cnt; s++)
+    {
+      size_t j;
+
+      memset (sector, 0, sizeof sector);
+      for (j = 0; j < RECS_PER_SECTOR && i < cnt; j++, i++)
+        sector[j] = trace_buf[(first + i) % TRACE_RECS];
+      block_write (scratch, s, sector);
+    }
+  printf ("Trace: %"PRIu32" events written to %s, %"PRIu32" lost\n",
+          cnt, block_name (scratch), first);
+}
+
+/* Returns the tid of the running thread.  Works as
+   running_thread() in thread.c, since thread_current() asserts
+   that the thread is running, which is not so in the middle of
+   a thread switch. */
+static uint16_t
+current_tid (void) 
+{
+  uint32_t *esp;
+
+  asm ("mov %%esp, %0" : "=g" (esp));
+  return ((struct thread *) pg_round_down (esp))->tid;
+}
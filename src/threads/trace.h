@@ -0,0 +1,75 @@
+#ifndef THREADS_TRACE_H
+#define THREADS_TRACE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Kernel event tracing.
+
+   With the kernel command-line option "-trace", kernel events are
+   recorded, with a time stamp and the running thread, in a ring
+   buffer that keeps the most recent TRACE_RECS of them.
+   Recording takes no lock.  At power off the buffer is written to
+   the scratch block device, where utils/tracedump decodes it. */
+
+/* Event types.  utils/tracedump.c has the same list. */
+enum trace_type
+  {
+    TRACE_SWITCH,               /* Thread switch: arg = next tid,
+                                   aux = old thread's status. */
+    TRACE_PAGE_FAULT,           /* Page fault: arg = address,
+                                   aux = error code. */
+    TRACE_SWAP_IN,              /* Page read from swap: arg = slot. */
+    TRACE_SWAP_OUT,             /* Page written to swap: arg = slot. */
+    TRACE_CACHE_HIT,            /* Buffer cache hit: arg = sector. */
+    TRACE_CACHE_MISS,           /* Buffer cache miss: arg = sector. */
+    TRACE_BLOCK_START,          /* Block I/O begins: arg = sector,
+                                   aux = block type << 1 | write. */
+    TRACE_BLOCK_DONE,           /* Block I/O ends: as TRACE_BLOCK_START. */
+    TRACE_SYSCALL_ENTER,        /* System call: arg = number. */
+    TRACE_SYSCALL_EXIT,         /* System call returns: arg = eax. */
+    TRACE_LOCK_WAIT,            /* Lock found held: arg = lock. */
+    TRACE_LOCK_ACQUIRE,         /* Lock acquired after waiting. */
+    TRACE_TYPE_CNT
+  };
+
+/* One event, in the buffer and in a dump. */
+struct trace_rec
+  {
+    uint64_t tsc;               /* Time stamp counter. */
+    uint32_t arg;               /* Argument, see enum trace_type. */
+    uint16_t tid;               /* Running thread. */
+    uint8_t type;               /* enum trace_type. */
+    uint8_t aux;                /* Second argument. */
+  };
+
+/* A dump is a header in sector 0 followed by the records, oldest
+   first, packed into the next sectors. */
+#define TRACE_MAGIC 0x43525450  /* "PTRC". */
+#define TRACE_VERSION 1
+struct trace_header
+  {
+    uint32_t magic;             /* TRACE_MAGIC. */
+    uint32_t version;           /* TRACE_VERSION. */
+    uint32_t rec_cnt;           /* Records in the dump. */
+    uint32_t lost;              /* Older records overwritten. */
+    uint64_t tsc_start;         /* Time stamp when tracing began. */
+    uint64_t tsc_hz;            /* Time stamp counts per second. */
+  };
+
+extern bool trace_enabled;
+
+void trace_init (void);
+void trace_record (enum trace_type, uint32_t arg, uint8_t aux);
+void trace_dump (void);
+
+/* Records an event of TYPE with arguments ARG and AUX if tracing
+   is on.  May be called from interrupt handlers. */
+static inline void
+trace_event (enum trace_type type, uint32_t arg, uint8_t aux)
+{
+  if (trace_enabled)
+    trace_record (type, arg, aux);
+}
+
+#endif /* threads/trace.h */
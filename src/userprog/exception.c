@@ -4,12 +4,15 @@
 #include "userprog/gdt.h"
 #include "threads/interrupt.h"
 #include "threads/thread.h"
+#include "threads/trace.h"
 #include "vm/page.h"
 #include "userprog/syscall.h"
 #include "threads/vaddr.h"
 #include "threads/palloc.h"
 #include "vm/swap.h"
+#include "vm/frame.h"
 #include "userprog/process.h"
+#include "userprog/uaccess.h"
 
 /* Number of page faults processed. */
 static long long page_fault_cnt;
@@ -153,46 +156,56 @@ page_fault (struct intr_frame *f)
   not_present = (f->error_code & PF_P) == 0;
   write = (f->error_code & PF_W) != 0;
   user = (f->error_code & PF_U) != 0;
+  trace_event (TRACE_PAGE_FAULT, (uint32_t) fault_addr, f->error_code);
 
   /**pj4****************************************************/
   if(not_present){
 	struct spt_entry *spte = find_spt_entry(fault_addr);
 	if(spte){
 	  void *kpage = 0;
-	  while(!(kpage = palloc_get_page(PAL_USER))){
-		page_evict();
-	  }
+	  //the page-out daemon may still be writing it out
+	  frame_wait(spte);
+	  if(spte->swap_idx == -1)
+		goto fail;
+	  int32_t slot = spte->swap_idx;
+	  if(!(kpage = frame_alloc(spte, 0)))
+		goto fail;
 	  swap_in(spte->vpn, kpage);
 	  if(!install_page(spte->vpn, kpage, spte->writable)){
-		palloc_free_page(kpage);
-		sys_exit(-1);
+		frame_remove(spte);
+		goto fail;
 	  }
+	  frame_unpin(spte);
+	  page_readaround(spte, slot);
+	  VMSTAT_ADD(thread_current(), major_faults, 1);
 	  return ;
 	}
-	else if(fault_addr >= f->esp - 32){
-	  void *vpn = pg_round_down(fault_addr);
-	  if(vpn >= PHYS_BASE - 8 * 1024 * 1024){
-		void *kpage = 0;
-		struct spt_entry *spte = malloc(sizeof(struct spt_entry));
-		while(!(kpage = palloc_get_page(PAL_USER)))
-		  page_evict();
-
-		spte->pfn = pg_round_down(kpage);
-		spte->vpn = vpn;
-		spte->writable = 1;
-		spte->pinned = 0;
-		spte->t = thread_current();
-		spte->swap_idx = -1;
-
-		if(!install_page(spte->vpn, kpage, 1) || !insert_spte(&thread_current()->spt, spte)){
-		  palloc_free_page(kpage);
-		  free(spte);
-		  sys_exit(-1);
-		}
+	//in kernel mode f->esp is the kernel stack, so use the user
+	//stack pointer saved at system call entry
+	else if(is_user_vaddr(fault_addr)
+			&& fault_addr >= (user ? f->esp : thread_current()->user_esp) - 32){
+	  if(page_stack_grow(fault_addr, write)){
+		VMSTAT_ADD(thread_current(), minor_faults, 1);
+		VMSTAT_ADD(thread_current(), stack_faults, 1);
 		return;
 	  }
 	}
   }
+  else if(write){
+	//first write to a page still backed by the zero page
+	struct spt_entry *spte = find_spt_entry(fault_addr);
+	if((spte && spte->zero && spte->writable && page_zero_fault(spte))
+	   //first write to a page shared with a forked process
+	   || (spte && spte->cow && page_cow_fault(spte))){
+	  VMSTAT_ADD(thread_current(), minor_faults, 1);
+	  return;
+	}
+  }
+  //a bad user address passed to a system call, or one that cannot
+  //be paged in, makes the accessor that touched it fail instead
+ fail:
+  if(!user && uaccess_fixup(f))
+	return;
   if(lock_held_by_current_thread(&f_lock))
     lock_release(&f_lock);
   sys_exit(-1);
@@ -7,7 +7,10 @@
 #include "threads/palloc.h"
 
 static uint32_t *active_pd (void);
-static void invalidate_pagedir (uint32_t *);
+static void invalidate_pagedir (uint32_t *, const void *);
+
+/* Page directory most recently loaded by pagedir_activate(). */
+static uint32_t *live_pd;
 
 /* Creates a new page directory that has mappings for kernel
    virtual addresses, but none for user virtual addresses.
@@ -151,9 +154,27 @@ pagedir_clear_page (uint32_t *pd, void *upage)
   if (pte != NULL && (*pte & PTE_P) != 0)
     {
       *pte &= ~PTE_P;
-      invalidate_pagedir (pd);
+      invalidate_pagedir (pd, upage);
+    }
+}
+
+/**pj4****************************************************/
+/* Sets the writable bit to WRITABLE in the PTE for virtual page
+   VPAGE in PD.  Has no effect if VPAGE is not mapped. */
+void
+pagedir_set_writable (uint32_t *pd, const void *vpage, bool writable)
+{
+  uint32_t *pte = lookup_page (pd, vpage, false);
+  if (pte != NULL && (*pte & PTE_P) != 0)
+    {
+      if (writable)
+        *pte |= PTE_W;
+      else
+        *pte &= ~(uint32_t) PTE_W;
+      invalidate_pagedir (pd, vpage);
     }
 }
+/*********************************************************/
 
 /* Returns true if the PTE for virtual page VPAGE in PD is dirty,
    that is, if the page has been modified since the PTE was
@@ -179,7 +200,7 @@ pagedir_set_dirty (uint32_t *pd, const void *vpage, bool dirty)
       else 
         {
           *pte &= ~(uint32_t) PTE_D;
-          invalidate_pagedir (pd);
+          invalidate_pagedir (pd, vpage);
         }
     }
 }
@@ -208,7 +229,7 @@ pagedir_set_accessed (uint32_t *pd, const void *vpage, bool accessed)
       else 
         {
           *pte &= ~(uint32_t) PTE_A; 
-          invalidate_pagedir (pd);
+          invalidate_pagedir (pd, vpage);
         }
     }
 }
@@ -227,6 +248,19 @@ pagedir_activate (uint32_t *pd)
      to/from Control Registers" and [IA32-v3a] 3.7.5 "Base
      Address of the Page Directory". */
   asm volatile ("movl %0, %%cr3" : : "r" (vtop (pd)) : "memory");
+  live_pd = pd;
+}
+
+/* Activates PD like pagedir_activate(), unless it is already the
+   live page directory, sparing the TLB flush that reloading CR3
+   implies. */
+void
+pagedir_switch (uint32_t *pd) 
+{
+  if (pd == NULL)
+    pd = init_page_dir;
+  if (pd != live_pd)
+    pagedir_activate (pd);
 }
 
 /* Returns the currently active page directory. */
@@ -244,19 +278,22 @@ active_pd (void)
 
 /* Seom page table changes can cause the CPU's translation
    lookaside buffer (TLB) to become out-of-sync with the page
-   table.  When this happens, we have to "invalidate" the TLB by
-   re-activating it.
+   table.  When this happens, we have to "invalidate" the stale
+   TLB entry.
 
-   This function invalidates the TLB if PD is the active page
-   directory.  (If PD is not active then its entries are not in
-   the TLB, so there is no need to invalidate anything.) */
+   This function invalidates the TLB entry for VPAGE if PD is the
+   active page directory.  (If PD is not active then its entries
+   are not in the TLB, so there is no need to invalidate
+   anything.) */
 static void
-invalidate_pagedir (uint32_t *pd) 
+invalidate_pagedir (uint32_t *pd, const void *vpage) 
 {
   if (active_pd () == pd) 
     {
-      /* Re-activating PD clears the TLB.  See [IA32-v3a] 3.12
-         "Translation Lookaside Buffers (TLBs)". */
-      pagedir_activate (pd);
+      /* Only VPAGE's entry can be stale, so drop just that one
+         rather than reloading CR3, which would flush the whole
+         TLB.  See [IA32-v3a] 3.12 "Translation Lookaside Buffers
+         (TLBs)". */
+      asm volatile ("invlpg (%0)" : : "r" (vpage) : "memory");
     } 
 }
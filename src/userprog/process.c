@@ -18,9 +18,11 @@
 #include "threads/thread.h"
 #include "threads/vaddr.h"
 #include "vm/page.h"
+#include "vm/frame.h"
 #include "userprog/syscall.h"
 
 static thread_func start_process NO_RETURN;
+static thread_func start_fork NO_RETURN;
 static bool load (const char *cmdline, void (**eip) (void), void **esp);
 
 /* Starts a new thread running a user program loaded from
@@ -76,6 +78,8 @@ start_process (void *file_name_)
 
   /**pj4**************************************************/
   spt_init(&thread_current()->spt);
+  //bounce page for read and write, see syscall.c
+  thread_current()->io_buf = palloc_get_page(0);
   /*******************************************************/
 
   /* Initialize interrupt frame and load executable. */
@@ -85,7 +89,8 @@ start_process (void *file_name_)
   if_.eflags = FLAG_IF | FLAG_MBS;
   
 
-  success = load (file_name, &if_.eip, &if_.esp);
+  success = thread_current()->io_buf != NULL
+            && load (file_name, &if_.eip, &if_.esp);
   
   /* If load failed, quit. */
   palloc_free_page (file_name);
@@ -107,6 +112,94 @@ start_process (void *file_name_)
   NOT_REACHED ();
 }
 
+/**pj2**************************************************/
+/* Passed from process_fork() to the child.  Lives on the
+   parent's stack, which stays put until the child signals
+   l_sema. */
+struct fork_aux
+  {
+    struct intr_frame if_;      /* Parent's state at fork(). */
+    struct thread *parent;
+    bool success;
+  };
+
+/* Creates a child process that is a copy of the current one,
+   resuming in user mode from the same fork() system call, whose
+   interrupt frame is F.  The address space is shared
+   copy-on-write.  Returns the child's thread id, or TID_ERROR
+   if the child could not be set up. */
+tid_t
+process_fork (struct intr_frame *f)
+{
+  struct fork_aux aux;
+  tid_t tid;
+
+  aux.if_ = *f;
+  aux.parent = thread_current ();
+  aux.success = false;
+  tid = thread_create (thread_name (), thread_get_priority (),
+                       start_fork, &aux);
+  if (tid == TID_ERROR)
+    return TID_ERROR;
+  sema_down (&thread_current ()->l_sema);
+  if (!aux.success)
+    {
+      process_wait (tid);
+      return TID_ERROR;
+    }
+  return tid;
+}
+
+/* A thread function that copies the address space and open
+   files of the process that called process_fork() and returns
+   to user mode with fork() returning 0. */
+static void
+start_fork (void *aux_)
+{
+  struct fork_aux *aux = aux_;
+  struct thread *t = thread_current ();
+  struct thread *parent = aux->parent;
+  struct intr_frame if_ = aux->if_;
+  bool success = false;
+
+  spt_init (&t->spt);
+  t->io_buf = palloc_get_page (0);
+  t->ustack = parent->ustack;
+  t->pagedir = pagedir_create ();
+  if (t->io_buf == NULL || t->pagedir == NULL)
+    goto done;
+  process_activate ();
+  if (!spt_fork (parent))
+    goto done;
+
+  /* FD_CNT grows with the copies, so sys_exit() closes exactly
+     the ones made if a later one fails. */
+  lock_acquire (&f_lock);
+  for (; t->fd_cnt < parent->fd_cnt; t->fd_cnt++)
+    {
+      struct file *file = parent->fd[t->fd_cnt];
+      if (file != NULL
+          && (t->fd[t->fd_cnt] = file_duplicate (file)) == NULL)
+        break;
+    }
+  lock_release (&f_lock);
+  success = t->fd_cnt == parent->fd_cnt;
+
+ done:
+  aux->success = success;
+  sema_up (&parent->l_sema);
+  if (!success)
+    {
+      t->flag = 1;
+      sys_exit (-1);
+    }
+
+  if_.eax = 0;
+  asm volatile ("movl %0, %%esp; jmp intr_exit" : : "g" (&if_) : "memory");
+  NOT_REACHED ();
+}
+/*******************************************************/
+
 /* Waits for thread TID to die and returns its exit status.  If
    it was terminated by the kernel (i.e. killed due to an
    exception), returns -1.  If TID is invalid or if it was not a
@@ -147,6 +240,8 @@ process_exit (void)
 
   /**pj4****************************************************/
   spt_destroy(&cur->spt);
+  palloc_free_page(cur->io_buf);
+  cur->io_buf = NULL;
   /*********************************************************/
   dir_close(cur->t_dir);
   pd = cur->pagedir;
@@ -181,8 +276,11 @@ process_activate (void)
 {
   struct thread *t = thread_current ();
 
-  /* Activate thread's page tables. */
-  pagedir_activate (t->pagedir);
+  /* Activate thread's page tables.  A kernel thread touches only
+     kernel memory, which every page directory maps alike, so it
+     keeps running on whichever one is live. */
+  if (t->pagedir != NULL)
+    pagedir_switch (t->pagedir);
 
   /* Set thread's kernel stack for use in processing
      interrupts. */
@@ -525,7 +623,7 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
   ASSERT (pg_ofs (upage) == 0);
   ASSERT (ofs % PGSIZE == 0);
 
-  file_seek (file, ofs);
+  struct inode *inode = file_get_inode (file);
   while (read_bytes > 0 || zero_bytes > 0) 
     {
       /* Calculate how to fill this page.
@@ -535,42 +633,57 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
       size_t page_zero_bytes = PGSIZE - page_read_bytes;
 	  
   /**pj4****************************************************/
-	  uint8_t *kpage;
-	  while(!(kpage = palloc_get_page (PAL_USER | PAL_ZERO)))
-		page_evict();
-  /*********************************************************/
-
-	  if(file_read(file, kpage, page_read_bytes) != (int)page_read_bytes)
-		{
-		palloc_free_page(kpage);
-		return false;
-		}
-	  memset(kpage + page_read_bytes, 0, page_zero_bytes);
-	  if(!install_page(upage, kpage, writable))
-		{
-		  palloc_free_page(kpage);
+	  if(page_read_bytes == 0){
+		//pure bss page: share the zero page until it is written
+		if(!page_map_zero(upage, writable))
 		  return false;
-		}
-  /**pj4******************************************************/
-	  struct spt_entry *spte = malloc(sizeof(struct spt_entry));
+		zero_bytes -= page_zero_bytes;
+		upage += PGSIZE;
+		continue;
+	  }
+	  struct spt_entry *spte = spte_alloc();
+	  if(!spte)
+		return false;
 	  spte->vpn = pg_round_down(upage);
 	  spte->writable = writable;
-	  spte->pinned = 0;
-	  spte->pfn = pg_round_down(kpage);
+	  spte->evicting = 0;
+	  spte->zero = 0;
+	  spte->cow = 0;
+	  spte->pfn = 0;
 	  spte->t = thread_current();
 	  spte->swap_idx = -1;
+	  spte->frame = 0;
 
+	  //from here on spt_destroy() cleans up after a failed load
 	  if(!insert_spte(&thread_current()->spt, spte)){
-		palloc_free_page(kpage);
-		free(spte);
+		spte_release(spte);
 		return false;
 	  }
+	  //text of a program that is already running is shared
+	  if(!writable && frame_text_lookup(inode, ofs, page_read_bytes, spte)){
+		if(!install_page(upage, spte->pfn, false))
+		  return false;
+	  }
+	  else{
+		uint8_t *kpage = frame_alloc(spte, 0);
+		if(!kpage)
+		  return false;
+		if(file_read_at(file, kpage, page_read_bytes, ofs) != (int)page_read_bytes)
+		  return false;
+		memset(kpage + page_read_bytes, 0, page_zero_bytes);
+		if(!install_page(upage, kpage, writable))
+		  return false;
+		if(!writable)
+		  frame_text_cache(spte, inode, ofs, page_read_bytes);
+		frame_unpin(spte);
+	  }
   /***********************************************************/
 
       /* Advance. */
       read_bytes -= page_read_bytes;
       zero_bytes -= page_zero_bytes;
       upage += PGSIZE;
+      ofs += page_read_bytes;
     }
   return true;
 }
@@ -580,33 +693,12 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
 static bool
 setup_stack (void **esp) 
 {
-  uint8_t *kpage;
   bool success = false;
 
   /**pj4*****************************************************/
-  while(!(kpage = palloc_get_page (PAL_USER | PAL_ZERO)))
-	page_evict();
-
-  success = install_page (((uint8_t *) PHYS_BASE) - PGSIZE, kpage, true);
-  if (success){
+  success = page_stack_init();
+  if (success)
 	*esp = PHYS_BASE;
-	struct spt_entry *spte = malloc(sizeof(struct spt_entry));
-
-	spte->vpn = pg_round_down(((uint8_t *) PHYS_BASE) - PGSIZE);
-	spte->writable = 1;
-	spte->pinned = 0;
-	spte->swap_idx = -1;
-	spte->t = thread_current();
-	spte->pfn = pg_round_down(kpage);
-
-	if(!insert_spte(&thread_current()->spt, spte)){
-	  palloc_free_page(kpage);
-	  free(spte);
-	  success = false;
-	}
-  }
-  else
-	palloc_free_page (kpage);
   
   /**********************************************************/
   return success;
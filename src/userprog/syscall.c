@@ -1,7 +1,9 @@
 #include <stdbool.h>
 #include <stdio.h>
+#include <string.h>
 #include <syscall-nr.h>
 #include "threads/interrupt.h"
+#include "threads/trace.h"
 #include "pagedir.h"
 #include "threads/vaddr.h"
 #include "filesys/file.h"
@@ -14,8 +16,10 @@
 #include "userprog/process.h"
 #include "threads/palloc.h"
 #include "vm/swap.h"
+#include "vm/frame.h"
 #include "filesys/directory.h"
 #include "filesys/inode.h"
+#include "userprog/uaccess.h"
 
 static void syscall_handler (struct intr_frame *);
 
@@ -26,72 +30,33 @@ syscall_init (void)
   intr_register_int (0x30, 3, INTR_ON, syscall_handler, "syscall");
 }
 
-/**pj1****************************************************/
-//check is in user address area
-void chk_addr_area(const void *addr, int offset, int end, int bytes){
-  for(int i = offset; i <= end; i += bytes){
-	//check address area
-	if(!(addr + i) || !is_user_vaddr(addr + i)){
+/**pj4****************************************************/
+/* Copies the user string USTR into DST, which has room for SIZE
+   bytes.  Returns false, leaving DST unusable, if USTR does not
+   fit: the system call must fail rather than act on a prefix of
+   the name it was given.  Kills the process if USTR is not a
+   valid user string. */
+static bool copy_in_string(char *dst, const char *ustr, size_t size){
+  const char *p;
+  char c;
+
+  if(strlcpy_from_user(dst, ustr, size))
+	return true;
+  //too long, or bad: the rest of the string must still be valid
+  for(p = ustr; ; p++){
+	if(!copy_from_user(&c, p, 1))
 	  sys_exit(-1);
-	}
-	struct spt_entry *spte = find_spt_entry(addr + i);
-
-	if(spte && spte->swap_idx != -1){
-	  void *kpage = 0;
-	  while(!(kpage = palloc_get_page(PAL_USER)))
-		page_evict();
-	  swap_in(spte->vpn, kpage);
-	  if(!install_page(spte->vpn, kpage, spte->writable)){
-		palloc_free_page(kpage);
-		sys_exit(-1);
-	  }
-	  spte->pinned = 1;
-	}
+	if(c == '\0')
+	  return false;
   }
 }
 
-/**pj4***************************************************/
-void chk_buffer_area(const void *buffer, unsigned size){
-  if(!(buffer) || !is_user_vaddr(buffer)){
-	  sys_exit(-1);
-	}
-  void *s_vpn = pg_round_down(buffer);
-  void *e_vpn = pg_round_down(buffer + size + PGSIZE);
-  for(; s_vpn != e_vpn; s_vpn += PGSIZE){
-	struct spt_entry *spte = find_spt_entry(s_vpn);
-	if(spte && spte->swap_idx != -1){
-	  void *kpage = 0;
-	  while(!(kpage = palloc_get_page(PAL_USER)))
-		page_evict();
-	  swap_in(spte->vpn, kpage);
-	  if(!install_page(spte->vpn, kpage, spte->writable)){
-		palloc_free_page(kpage);
-		sys_exit(-1);
-	  }
-	  spte->pinned = 1;
-	}
-/*	else{
-	  if(s_vpn >= PHYS_BASE - 8 * 1024 * 1024){
-		void *kpage = 0;
-		struct spt_entry *spte = malloc(sizeof(struct spt_entry));
-		while(!(kpage = palloc_get_page(PAL_USER)))
-		  page_evict();
-
-		spte->pfn = pg_round_down(kpage);
-		spte->vpn = s_vpn;
-		spte->writable = 1;
-		spte->pinned = 1;
-		spte->t = thread_current();
-		spte->swap_idx = -1;
-
-		if(!install_page(spte->vpn, kpage, 1) || !insert_spte(&thread_current()->spt, spte)){
-		  palloc_free_page(kpage);
-		  free(spte);
-		  sys_exit(-1);
-		}
-	  }
-	}*/
-  }
+/* Copies the system call number and the first CNT arguments
+   from the user stack of F into ARG.  Kills the process if the
+   user stack pointer is bad. */
+static void get_args(struct intr_frame *f, uint32_t *arg, int cnt){
+  if(!copy_from_user(arg, f->esp, (cnt + 1) * sizeof *arg))
+	sys_exit(-1);
 }
 /********************************************************/
 
@@ -115,11 +80,19 @@ void sys_exit(int status){
 tid_t sys_exec(const char *cmd_line){
   char exec_name[30];
   int i = 0;
+  char *kcmd = palloc_get_page(0);
+  tid_t tid = -1;
+
+  if(!kcmd)
+	return -1;
+  if(!copy_in_string(kcmd, cmd_line, PGSIZE)){
+	palloc_free_page(kcmd);
+	return -1;
+  }
  
-  chk_addr_area(cmd_line, 0, 0, 4);
   //parsing for print
-  while (cmd_line[i] && cmd_line[i] != ' '){
-	exec_name[i] = cmd_line[i];
+  while (kcmd[i] && kcmd[i] != ' '){
+	exec_name[i] = kcmd[i];
 	i++;
   }
   exec_name[i] = 0;
@@ -128,59 +101,108 @@ tid_t sys_exec(const char *cmd_line){
   lock_acquire(&f_lock);
   struct file *f = filesys_open(exec_name);
   lock_release(&f_lock);
-  if(!f)
-	return -1;
-  file_close(f);
-  return process_execute(cmd_line);
+  if(f){
+	file_close(f);
+	tid = process_execute(kcmd);
+  }
+  palloc_free_page(kcmd);
+  return tid;
 }
 
+/**pj4***************************************************/
+tid_t sys_fork(struct intr_frame *f){
+  return process_fork(f);
+}
+
+bool sys_vmstat(int which, struct vmstat *st){
+  struct vmstat kst;
+
+  if(which != VMSTAT_SELF && which != VMSTAT_ALL)
+	return false;
+  frame_get_stats(which == VMSTAT_SELF ? thread_current() : 0, &kst);
+  if(!copy_to_user(st, &kst, sizeof kst))
+	sys_exit(-1);
+  return true;
+}
+
+bool sys_schedstat(tid_t tid, struct schedstat *st){
+  struct schedstat kst;
+
+  if(!thread_get_schedstat(tid, &kst))
+	return false;
+  if(!copy_to_user(st, &kst, sizeof kst))
+	sys_exit(-1);
+  return true;
+}
+/*********************************************************/
+
 int sys_wait(tid_t pid){
   return process_wait(pid);
 }
 
+/* Reads and writes go through the process's bounce page, so the
+   file system never touches user memory and a bad buffer only
+   makes copy_to_user() or copy_from_user() fail. */
 int sys_read(int fd, void *buffer, unsigned size){
-  chk_buffer_area(buffer, size);
   struct thread *t = thread_current();
-  unsigned int i = 0;
-  if(fd == 0){
-	//save one char by one
-	lock_acquire(&f_lock);
-	while(i < size)
-	  ((char *)buffer)[i++] = input_getc();
-	//if don't loop 'size' time , error
-	lock_release(&f_lock);
-	return i;
-  }
-  else if(2 <= fd && fd < t->fd_cnt){
-	//read using file descriptor
+  unsigned ret = 0;
+  char *kbuf = t->io_buf;
+
+  if(fd != 0 && (fd < 2 || fd >= t->fd_cnt))
+	return -1;
+  while(ret < size){
+	unsigned chunk = size - ret < PGSIZE ? size - ret : PGSIZE;
+	unsigned n = 0;
+
 	lock_acquire(&f_lock);
-	int ret = file_read(t->fd[fd], buffer, size);
+	if(fd == 0){
+	  //save one char by one
+	  while(n < chunk)
+		kbuf[n++] = input_getc();
+	}
+	else
+	  //read using file descriptor
+	  n = file_read(t->fd[fd], kbuf, chunk);
 	lock_release(&f_lock);
-	return ret;
+	if(!copy_to_user(buffer + ret, kbuf, n))
+	  sys_exit(-1);
+	ret += n;
+	if(n < chunk)
+	  break;
   }
-  return -1;
+  return ret;
 }
 
 int sys_write(int fd, const void *buffer, unsigned size){
-  chk_buffer_area(buffer, size);
   struct thread *t = thread_current();
-  if(fd == 1){
-	lock_acquire(&f_lock);
-	putbuf(buffer, size);
-	lock_release(&f_lock);
-	return size;
-  }
-  else if(2 <= fd && fd < t->fd_cnt){
-	//write using file descriptor
+  unsigned ret = 0;
+  char *kbuf = t->io_buf;
+
+  if(fd != 1 && (fd < 2 || fd >= t->fd_cnt))
+	return -1;
+  while(ret < size){
+	unsigned chunk = size - ret < PGSIZE ? size - ret : PGSIZE;
+	unsigned n;
+
+	if(!copy_from_user(kbuf, buffer + ret, chunk))
+	  sys_exit(-1);
 	lock_acquire(&f_lock);
-	//deny writing executing file
-	chk_deny_write(t->fd[fd], 0, 0);
-	
-	int ret = file_write(t->fd[fd], buffer, size);
+	if(fd == 1){
+	  putbuf(kbuf, chunk);
+	  n = chunk;
+	}
+	else{
+	  //write using file descriptor
+	  //deny writing executing file
+	  chk_deny_write(t->fd[fd], 0, 0);
+	  n = file_write(t->fd[fd], kbuf, chunk);
+	}
 	lock_release(&f_lock);
-	return ret;
+	ret += n;
+	if(n < chunk)
+	  break;
   }
-  return -1;
+  return ret;
 }
 
 int fibonacci(int n){
@@ -203,36 +225,43 @@ int max_of_four_int(int a, int b, int c, int d){
 }
 /**pj2****************************************************/
 bool sys_create(const char *file, unsigned initial_size){
-  chk_addr_area(file, 0, 0, 4);
+  char kfile[PATH_LEN + 1];
+  if(!copy_in_string(kfile, file, sizeof kfile))
+	return false;
   lock_acquire(&f_lock);
-  int ret = filesys_create(file, initial_size);
+  int ret = filesys_create(kfile, initial_size);
   lock_release(&f_lock);
   return ret;
 }
 
 bool sys_remove(const char *file){
-  chk_addr_area(file, 0, 0, 4);
+  char kfile[PATH_LEN + 1];
+  if(!copy_in_string(kfile, file, sizeof kfile))
+	return false;
   lock_acquire(&f_lock);
-  int ret = filesys_remove(file);
+  int ret = filesys_remove(kfile);
   lock_release(&f_lock);
   return ret;
 }
 
 int sys_open(const char *file){
-  chk_addr_area(file, 0, 0, 4);
+  char kfile[PATH_LEN + 1];
   struct thread *t = thread_current();
+  int fd = -1;
+  if(!copy_in_string(kfile, file, sizeof kfile))
+	return -1;
   lock_acquire(&f_lock);
-  struct file *f = filesys_open(file);
+  struct file *f = filesys_open(kfile);
   lock_release(&f_lock);
   if(f){
 	if(t->fd_cnt < 128){
 	  //file == thread_name -> deny_write
-	  chk_deny_write(f, t->name, file);
+	  chk_deny_write(f, t->name, kfile);
 	  t->fd[t->fd_cnt++] = f;
-	  return t->fd_cnt - 1;
+	  fd = t->fd_cnt - 1;
 	}
   }
-  return -1;
+  return fd;
 }
 
 void sys_close(int fd){
@@ -274,7 +303,8 @@ bool sys_isdir(int fd){
 bool sys_chdir(char *path){
   char tmp[PATH_LEN + 1];
   char name[PATH_LEN + 1];
-  strlcpy(tmp, path, PATH_LEN);
+  if(!copy_in_string(tmp, path, PATH_LEN))
+	return false;
   strlcat(tmp, "/0", PATH_LEN);
   struct dir *dir = path_parsing(tmp, name);
   if(!dir)
@@ -284,7 +314,11 @@ bool sys_chdir(char *path){
   return true;
 }
 bool sys_mkdir(const char *dir){
-  return filesys_create_dir(dir);
+  char kdir[PATH_LEN + 1];
+  if(!copy_in_string(kdir, dir, sizeof kdir))
+	return false;
+  bool ret = filesys_create_dir(kdir);
+  return ret;
 }
 bool sys_readdir(int fd, char *name){
   struct file *file = thread_current()->fd[fd];
@@ -298,11 +332,14 @@ bool sys_readdir(int fd, char *name){
 	return false;
   int i = 0;
   bool result = true;
+  char kname[NAME_MAX + 1];
   off_t *pos = (off_t *)file + 1;
   for(i=0;i<= *pos && result; i++)
-	result = dir_readdir(dir, name);
+	result = dir_readdir(dir, kname);
   if(i <= *pos == false)
 	(*pos)++;
+  if(result && !copy_to_user(name, kname, strlen(kname) + 1))
+	sys_exit(-1);
   return result;
 }
 int sys_inumber(int fd){
@@ -315,92 +352,107 @@ int sys_inumber(int fd){
 static void
 syscall_handler (struct intr_frame *f UNUSED) 
 {
-  int sys_num;
-  chk_addr_area(f->esp, 0, 0, 4);
-  sys_num = *(uint32_t *)f->esp;
+  //system call number and up to four arguments
+  uint32_t arg[5];
+
+  thread_current()->user_esp = f->esp;
+  get_args(f, arg, 0);
+  trace_event(TRACE_SYSCALL_ENTER, arg[0], 0);
  
-  //first check addr, second call system_call function
-  switch(sys_num){
+  //first copy in args, second call system_call function
+  switch(arg[0]){
 	case SYS_HALT:
 	  sys_halt();
 	  break;
 	case SYS_EXIT:
-	  chk_addr_area(f->esp, 4, 4, 4);
-	  sys_exit(*(uint32_t *)(f->esp + 4));
+	  get_args(f, arg, 1);
+	  sys_exit(arg[1]);
 	  break;
 	case SYS_EXEC:
-	  chk_addr_area(f->esp, 4, 4, 4);
-	  f->eax = sys_exec((char *)*(uint32_t *)(f->esp + 4));
+	  get_args(f, arg, 1);
+	  f->eax = sys_exec((char *)arg[1]);
 	  break;
 	case SYS_WAIT:
-	  chk_addr_area(f->esp, 4, 4, 4);
-	  f->eax = sys_wait(*(uint32_t *)(f->esp + 4));
+	  get_args(f, arg, 1);
+	  f->eax = sys_wait(arg[1]);
 	  break;
 	case SYS_READ:
-	  chk_addr_area(f->esp, 4, 12, 4);
-	  f->eax = sys_read(*(uint32_t *)(f->esp + 4), *(uint32_t *)(f->esp + 8), *(uint32_t *)(f->esp + 12));
+	  get_args(f, arg, 3);
+	  f->eax = sys_read(arg[1], (void *)arg[2], arg[3]);
 	  break;
 	case SYS_WRITE:
-	  chk_addr_area(f->esp, 4, 12, 4);
-	  f->eax = sys_write(*(uint32_t *)(f->esp + 4), *(uint32_t *)(f->esp + 8), *(uint32_t *)(f->esp + 12));
+	  get_args(f, arg, 3);
+	  f->eax = sys_write(arg[1], (void *)arg[2], arg[3]);
 	  break;
 	case SYS_FIBO:
-	  chk_addr_area(f->esp, 4, 4, 4);
-	  f->eax = fibonacci(*(uint32_t *)(f->esp + 4));
+	  get_args(f, arg, 1);
+	  f->eax = fibonacci(arg[1]);
 	  break;
 	case SYS_MAX_FOUR:
-	  chk_addr_area(f->esp, 4, 16, 4);
-	  f->eax = max_of_four_int(*(uint32_t *)(f->esp + 4), *(uint32_t *)(f->esp + 8), *(uint32_t *)(f->esp + 12), *(uint32_t *)(f->esp + 16));
+	  get_args(f, arg, 4);
+	  f->eax = max_of_four_int(arg[1], arg[2], arg[3], arg[4]);
 	  break;
 	case SYS_CREATE:
-	  chk_addr_area(f->esp, 4, 8, 4);
-	  f->eax = sys_create((char *)*(uint32_t *)(f->esp + 4), *(uint32_t *)(f->esp + 8));
+	  get_args(f, arg, 2);
+	  f->eax = sys_create((char *)arg[1], arg[2]);
 	  break;
 	case SYS_REMOVE:
-	  chk_addr_area(f->esp, 4, 4, 4);
-	  f->eax = sys_remove((char *)*(uint32_t *)(f->esp + 4));
+	  get_args(f, arg, 1);
+	  f->eax = sys_remove((char *)arg[1]);
 	  break;
 	case SYS_OPEN:
-	  chk_addr_area(f->esp, 4, 4, 4);
-	  f->eax = sys_open((char *)*(uint32_t *)(f->esp + 4));
+	  get_args(f, arg, 1);
+	  f->eax = sys_open((char *)arg[1]);
 	  break;
 	case SYS_CLOSE:
-	  chk_addr_area(f->esp, 4, 4, 4);
-	  sys_close(*(uint32_t *)(f->esp + 4));
+	  get_args(f, arg, 1);
+	  sys_close(arg[1]);
 	  break;
 	case SYS_FILESIZE:
-	  chk_addr_area(f->esp, 4, 4, 4);
-	  f->eax = sys_filesize(*(uint32_t *)(f->esp + 4));
+	  get_args(f, arg, 1);
+	  f->eax = sys_filesize(arg[1]);
 	  break;
 	case SYS_SEEK:
-	  chk_addr_area(f->esp, 4, 8, 4);
-	  sys_seek(*(uint32_t *)(f->esp + 4), *(uint32_t *)(f->esp + 8));
+	  get_args(f, arg, 2);
+	  sys_seek(arg[1], arg[2]);
 	  break;
 	case SYS_TELL:
-	  chk_addr_area(f->esp, 4, 4, 4);
-	  f->eax = sys_tell(*(uint32_t *)(f->esp + 4));
+	  get_args(f, arg, 1);
+	  f->eax = sys_tell(arg[1]);
 	  break;
 	case SYS_ISDIR:
-	  chk_addr_area(f->esp, 4, 4, 4);
-	  f->eax = sys_isdir(*(uint32_t *)(f->esp + 4));
+	  get_args(f, arg, 1);
+	  f->eax = sys_isdir(arg[1]);
 	  break;
 	case SYS_CHDIR:
-	  chk_addr_area(f->esp, 4, 4, 4);
-	  f->eax = sys_chdir(*(uint32_t *)(f->esp + 4));
+	  get_args(f, arg, 1);
+	  f->eax = sys_chdir((char *)arg[1]);
 	  break;
 	case SYS_MKDIR:
-	  chk_addr_area(f->esp, 4, 4, 4);
-	  f->eax = sys_mkdir(*(uint32_t *)(f->esp + 4));
+	  get_args(f, arg, 1);
+	  f->eax = sys_mkdir((char *)arg[1]);
 	  break;
 	case SYS_READDIR:
-	  chk_addr_area(f->esp, 4, 8, 4);
-	  f->eax = sys_readdir((char *)*(uint32_t *)(f->esp + 4), *(uint32_t *)(f->esp + 8));
+	  get_args(f, arg, 2);
+	  f->eax = sys_readdir(arg[1], (char *)arg[2]);
 	  break;
 	case SYS_INUMBER:
-	  chk_addr_area(f->esp, 4, 4, 4);
-	  f->eax = sys_inumber(*(uint32_t *)(f->esp + 4));
+	  get_args(f, arg, 1);
+	  f->eax = sys_inumber(arg[1]);
+	  break;
+	case SYS_FORK:
+	  f->eax = sys_fork(f);
+	  break;
+	case SYS_VMSTAT:
+	  get_args(f, arg, 2);
+	  f->eax = sys_vmstat(arg[1], (struct vmstat *)arg[2]);
+	  break;
+	case SYS_SCHEDSTAT:
+	  get_args(f, arg, 2);
+	  f->eax = sys_schedstat(arg[1], (struct schedstat *)arg[2]);
 	  break;
   }
+  trace_event(TRACE_SYSCALL_EXIT, f->eax, 0);
 }
 
 /*********************************************************/
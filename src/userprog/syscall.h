@@ -1,6 +1,9 @@
 #ifndef USERPROG_SYSCALL_H
 #define USERPROG_SYSCALL_H
 
+#include "threads/interrupt.h"
+#include <vmstat.h>
+
 typedef int mapid_t;
 
 struct lock f_lock;
@@ -23,14 +26,15 @@ void sys_close(int fd);
 int sys_filesize(int fd);
 void sys_seek(int fd, unsigned position);
 unsigned sys_tell(int fd);
-void chk_addr_area(const void *addr, int offset, int end, int bytes);
-/**pj4*******************************************************/
-void chk_buffer_area(const void *buffer, unsigned size);
 /**pj5*******************************************************/
 bool sys_isdir(int fd);
 bool sys_chdir(char *path);
 bool sys_mkdir(const char *dir);
 bool sys_readdir(int fd, char *name);
 int sys_inumber(int fd);
+/**pj4*******************************************************/
+tid_t sys_fork(struct intr_frame *f);
+bool sys_vmstat(int which, struct vmstat *st);
+bool sys_schedstat(tid_t tid, struct schedstat *st);
 /************************************************************/
 #endif /* userprog/syscall.h */
@@ -0,0 +1,129 @@
+#include "userprog/uaccess.h"
+#include <stdint.h>
+#include "threads/vaddr.h"
+
+/* Kernel accesses to user memory.
+
+   Each instruction below that touches user memory has an entry
+   in the exception table, a list of (instruction, fixup) address
+   pairs that the linker gathers between _start_ex_table and
+   _end_ex_table.  A page fault at such an instruction is first
+   handled like any other, so pages that are swapped out, not yet
+   grown or copy-on-write are brought in as usual.  Only if the
+   address turns out to be invalid does page_fault() resume at
+   the fixup instead of killing the process, and the accessor
+   returns failure.  Callers therefore need not look up or pin
+   user pages before touching them. */
+
+/* One exception table entry. */
+struct ex_entry
+  {
+    uintptr_t insn;             /* Instruction that may fault. */
+    uintptr_t fixup;            /* Where to resume if it does. */
+  };
+
+extern const struct ex_entry _start_ex_table[], _end_ex_table[];
+
+/* Emits an exception table entry for INSN, which resumes at
+   FIXUP. */
+#define EX_TABLE(INSN, FIXUP)                           \
+        ".section __ex_table, \"a\"\n\t"                \
+        ".long " INSN ", " FIXUP "\n\t"                 \
+        ".previous\n\t"
+
+/* Returns true if the SIZE bytes at UADDR all lie in user
+   virtual memory. */
+static bool
+is_user_range (const void *uaddr, size_t size)
+{
+  uintptr_t start = (uintptr_t) uaddr;
+  return start + size >= start && start + size <= (uintptr_t) PHYS_BASE;
+}
+
+/* Copies SIZE bytes from SRC to DST, either of which may be a
+   user address, and returns the number of bytes not copied
+   because of an invalid user address. */
+static size_t
+copy_raw (void *dst, const void *src, size_t size)
+{
+  asm volatile ("1: rep movsb\n\t"
+                "2:\n\t"
+                EX_TABLE ("1b", "2b")
+                : "+c" (size), "+D" (dst), "+S" (src)
+                :
+                : "memory");
+  return size;
+}
+
+/* Copies SIZE bytes from user address USRC to DST.  Returns
+   true if successful, false if USRC is not a valid user
+   range. */
+bool
+copy_from_user (void *dst, const void *usrc, size_t size)
+{
+  return is_user_range (usrc, size) && copy_raw (dst, usrc, size) == 0;
+}
+
+/* Copies SIZE bytes from SRC to user address UDST.  Returns
+   true if successful, false if UDST is not a valid, writable
+   user range. */
+bool
+copy_to_user (void *udst, const void *src, size_t size)
+{
+  return is_user_range (udst, size) && copy_raw (udst, src, size) == 0;
+}
+
+/* Returns the byte at user address UADDR, or -1 if UADDR is not
+   a valid user address. */
+static int
+get_user (const uint8_t *uaddr)
+{
+  int result = -1;
+
+  if (!is_user_vaddr (uaddr))
+    return -1;
+  asm volatile ("1: movzbl %1, %0\n\t"
+                "2:\n\t"
+                EX_TABLE ("1b", "2b")
+                : "+r" (result)
+                : "m" (*uaddr));
+  return result;
+}
+
+/* Copies the null-terminated string at user address USRC into
+   DST, which has room for SIZE bytes.  Returns true if
+   successful, false if USRC is not a valid user string or does
+   not fit. */
+bool
+strlcpy_from_user (char *dst, const char *usrc, size_t size)
+{
+  size_t i;
+
+  for (i = 0; i < size; i++)
+    {
+      int c = get_user ((const uint8_t *) usrc + i);
+      if (c < 0)
+        return false;
+      dst[i] = c;
+      if (c == '\0')
+        return true;
+    }
+  return false;
+}
+
+/* If F is a page fault in one of the accessors above, makes it
+   resume at the accessor's fixup and returns true.  Otherwise
+   returns false. */
+bool
+uaccess_fixup (struct intr_frame *f)
+{
+  const struct ex_entry *e;
+
+  for (e = _start_ex_table; e < _end_ex_table; e++)
+    if (e->insn == (uintptr_t) f->eip)
+      {
+        f->eip = (void (*) (void)) e->fixup;
+        return true;
+      }
+  return false;
+}
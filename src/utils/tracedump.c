@@ -0,0 +1,167 @@
+#include <errno.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Decodes the kernel event trace that "pintos -- -trace" writes
+   to the scratch device (see threads/trace.h) into a timeline,
+   one event per line. */
+
+#define SECTOR_SIZE 512
+#define REC_SIZE 16
+#define TRACE_MAGIC 0x43525450
+#define TRACE_VERSION 1
+
+/* Event types, as enum trace_type in threads/trace.h. */
+static const char *type_names[] =
+  {
+    "switch", "page-fault", "swap-in", "swap-out", "cache-hit",
+    "cache-miss", "block-start", "block-done", "syscall",
+    "syscall-ret", "lock-wait", "lock-acquire",
+  };
+#define TYPE_CNT (sizeof type_names / sizeof *type_names)
+
+/* Thread states, as enum thread_status in threads/thread.h. */
+static const char *status_names[] =
+  { "running", "ready", "blocked", "dying" };
+
+/* Block device types, as enum block_type in devices/block.h. */
+static const char *block_names[] =
+  { "kernel", "filesys", "scratch", "swap", "raw", "foreign" };
+
+/* Returns the little-endian integer of SIZE bytes at P. */
+static uint64_t
+get_le (const unsigned char *p, int size) 
+{
+  uint64_t v = 0;
+  int i;
+
+  for (i = size - 1; i >= 0; i--)
+    v = (v << 8) | p[i];
+  return v;
+}
+
+/* Prints the arguments of an event of TYPE. */
+static void
+print_args (unsigned type, uint32_t arg, unsigned aux) 
+{
+  switch (type) 
+    {
+    case 0:
+      printf ("-> tid %"PRIu32" (was %s)", arg,
+              aux < 4 ? status_names[aux] : "?");
+      break;
+    case 1:
+      printf ("0x%08"PRIx32" %s %s %s", arg,
+              aux & 1 ? "protection" : "not-present",
+              aux & 2 ? "write" : "read", aux & 4 ? "user" : "kernel");
+      break;
+    case 2:
+    case 3:
+      printf ("slot %s%"PRIu32, arg & 0x40000000 ? "zip:" : "",
+              arg & ~0x40000000u);
+      break;
+    case 4:
+    case 5:
+      printf ("sector %"PRIu32" %s", arg, aux ? "write" : "read");
+      break;
+    case 6:
+    case 7:
+      printf ("%s sector %"PRIu32" %s",
+              (aux >> 1) < 6 ? block_names[aux >> 1] : "?", arg,
+              aux & 1 ? "write" : "read");
+      break;
+    case 8:
+      printf ("#%"PRIu32, arg);
+      break;
+    case 9:
+      printf ("= %"PRId32, (int32_t) arg);
+      break;
+    default:
+      printf ("lock 0x%08"PRIx32, arg);
+      break;
+    }
+}
+
+int
+main (int argc, char *argv[]) 
+{
+  unsigned char sector[SECTOR_SIZE];
+  uint32_t rec_cnt, lost, i;
+  uint64_t tsc_start, tsc_hz;
+  long offset = 0;
+  FILE *f;
+
+  if (argc != 2 && argc != 3)
+    {
+      fprintf (stderr,
+               "tracedump: prints a Pintos kernel event trace\n"
+               "usage: %s FILE [OFFSET]\n"
+               "  where FILE is an image of the scratch device after\n"
+               "    running Pintos with -trace, and OFFSET is the byte\n"
+               "    offset of the scratch partition within FILE.\n",
+               argv[0]);
+      return EXIT_FAILURE;
+    }
+  if (argc == 3)
+    offset = strtol (argv[2], NULL, 0);
+
+  f = fopen (argv[1], "rb");
+  if (f == NULL || fseek (f, offset, SEEK_SET) != 0
+      || fread (sector, SECTOR_SIZE, 1, f) != 1)
+    {
+      fprintf (stderr, "%s: %s: %s\n", argv[0], argv[1],
+               f == NULL || ferror (f) ? strerror (errno) : "too short");
+      return EXIT_FAILURE;
+    }
+  if (get_le (sector, 4) != TRACE_MAGIC
+      || get_le (sector + 4, 4) != TRACE_VERSION)
+    {
+      fprintf (stderr, "%s: %s: not a version %d trace\n",
+               argv[0], argv[1], TRACE_VERSION);
+      return EXIT_FAILURE;
+    }
+  rec_cnt = get_le (sector + 8, 4);
+  lost = get_le (sector + 12, 4);
+  tsc_start = get_le (sector + 16, 8);
+  tsc_hz = get_le (sector + 24, 8);
+
+  printf ("%"PRIu32" events, %"PRIu32" earlier events lost, ",
+          rec_cnt, lost);
+  if (tsc_hz != 0)
+    printf ("times in ms at %.1f MHz\n", tsc_hz / 1e6);
+  else
+    printf ("times in cycles\n");
+
+  for (i = 0; i < rec_cnt; i++) 
+    {
+      unsigned char rec[REC_SIZE];
+      uint64_t tsc;
+      unsigned type;
+
+      if (i % (SECTOR_SIZE / REC_SIZE) == 0
+          && fread (sector, SECTOR_SIZE, 1, f) != 1)
+        {
+          fprintf (stderr, "%s: %s: truncated after %"PRIu32" events\n",
+                   argv[0], argv[1], i);
+          return EXIT_FAILURE;
+        }
+      memcpy (rec, sector + i % (SECTOR_SIZE / REC_SIZE) * REC_SIZE,
+              REC_SIZE);
+
+      tsc = get_le (rec, 8) - tsc_start;
+      type = rec[14];
+      if (tsc_hz != 0)
+        printf ("%12.6f", tsc * 1e3 / tsc_hz);
+      else
+        printf ("%12"PRIu64, tsc);
+      printf ("  tid %-4u %-12s ", (unsigned) get_le (rec + 12, 2),
+              type < TYPE_CNT ? type_names[type] : "?");
+      print_args (type, get_le (rec + 8, 4), rec[15]);
+      putchar ('\n');
+    }
+  fclose (f);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,557 @@
+#include "vm/frame.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "vm/swap.h"
+#include "filesys/inode.h"
+#include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "userprog/syscall.h"
+
+/* Every user frame that backs a page in some process's spt.
+   Victims are chosen by a clock hand sweeping this list. */
+static struct list frame_list;
+static struct list_elem *clock_hand;
+static struct lock frame_lock;
+
+/* Read-only executable pages, keyed by inode and file offset,
+   so every process running one program maps the same frames.
+   Writes to a cached inode are denied, so entries never go
+   stale. */
+static struct hash text_cache;
+
+/* Signaled whenever a batch of evicted frames has reached swap. */
+static struct condition evict_cond;
+
+/* Resident-set limits in frames, set by -rss-soft and -rss-hard.
+   A process above its soft limit gives up frames first; the
+   default, 0, is an equal share of the user pool among the
+   processes holding frames.  A process at its hard limit, if
+   any, replaces its own pages. */
+size_t rss_soft_limit;
+size_t rss_hard_limit;
+
+/* Number of threads with a nonzero rss. */
+static int rss_procs;
+
+/* Times frame_alloc() waits for something to become evictable
+   before giving up. */
+#define FRAME_ALLOC_TRIES 64
+
+/* Statistics. */
+static long long alloc_cnt;             /* Frames allocated. */
+static long long evict_cnt;             /* Frames evicted. */
+static long long alloc_fail_cnt;        /* Allocations given up. */
+struct vmstat vm_stats;
+
+static void pageout_daemon(void *aux);
+static size_t evict(size_t cnt, struct thread *only);
+
+/* Counts SPTE's new frame in its thread's rss. */
+static void rss_charge(struct spt_entry *spte){
+  if(spte->t->rss++ == 0)
+    rss_procs++;
+}
+
+/* Takes SPTE's frame out of its thread's rss. */
+static void rss_uncharge(struct spt_entry *spte){
+  if(--spte->t->rss == 0)
+    rss_procs--;
+}
+
+/* Returns true if T holds more frames than its soft limit and,
+   unless ANY_WS, more than its working set as well. */
+static bool rss_over(struct thread *t, bool any_ws){
+  size_t soft = rss_soft_limit;
+  if(!soft)
+    soft = palloc_user_page_cnt() / (rss_procs ? rss_procs : 1);
+  return (size_t) t->rss > soft && (any_ws || t->rss > t->wss);
+}
+
+/* Folds the referenced frames counted during the last sweep of
+   the clock into T's working set estimate. */
+static void ws_update(struct thread *t, void *aux UNUSED){
+  t->wss = (t->wss + t->ws_ref) / 2;
+  t->ws_ref = 0;
+}
+
+static unsigned text_hash(const struct hash_elem *e, void *aux UNUSED){
+  const struct frame *f = hash_entry(e, struct frame, t_elem);
+  return hash_int((int)f->inode) ^ hash_int(f->ofs);
+}
+
+static bool text_less(const struct hash_elem *a_, const struct hash_elem *b_, void *aux UNUSED){
+  const struct frame *a = hash_entry(a_, struct frame, t_elem);
+  const struct frame *b = hash_entry(b_, struct frame, t_elem);
+  if(a->inode != b->inode)
+    return a->inode < b->inode;
+  if(a->ofs != b->ofs)
+    return a->ofs < b->ofs;
+  return a->read_bytes < b->read_bytes;
+}
+
+/* Takes F out of the text cache and returns the inode it held,
+   which the caller must pass to text_release() after releasing
+   frame_lock, or a null pointer if F was not cached. */
+static struct inode *text_uncache(struct frame *f){
+  struct inode *inode = f->inode;
+  if(inode){
+    hash_delete(&text_cache, &f->t_elem);
+    f->inode = 0;
+  }
+  return inode;
+}
+
+/* Opens INODE again and denies writes to it, for the text
+   cache, under the file system lock.  Must be called without
+   frame_lock, since threads holding the file system lock may
+   wait for evictions. */
+static void text_hold(struct inode *inode){
+  bool held = lock_held_by_current_thread(&f_lock);
+
+  if(!held)
+    lock_acquire(&f_lock);
+  inode_reopen(inode);
+  inode_deny_write(inode);
+  if(!held)
+    lock_release(&f_lock);
+}
+
+/* Undoes text_hold() for INODE, dropped from the text cache.
+   The same locking rules apply. */
+static void text_release(struct inode *inode){
+  bool held = lock_held_by_current_thread(&f_lock);
+
+  if(!held)
+    lock_acquire(&f_lock);
+  inode_allow_write(inode);
+  inode_close(inode);
+  if(!held)
+    lock_release(&f_lock);
+}
+
+void frame_init(void){
+  list_init(&frame_list);
+  hash_init(&text_cache, text_hash, text_less, 0);
+  lock_init(&frame_lock);
+  cond_init(&evict_cond);
+  clock_hand = list_end(&frame_list);
+}
+
+/* Gets a page from the user pool for thread T, evicting frames
+   when it is empty.  A process at its hard limit first replaces
+   its own pages.  Returns a null pointer if FRAME_NOEVICT is in
+   FLAGS and the pool is empty, or if nothing could be evicted
+   for FRAME_ALLOC_TRIES tries in a row. */
+static void *frame_get_page(struct thread *t, enum frame_flags flags){
+  enum palloc_flags pflags = PAL_USER | (flags & FRAME_ZERO ? PAL_ZERO : 0);
+  void *kpage;
+  int tries = 0;
+
+  size_t n;
+
+  if(rss_hard_limit && (size_t) t->rss >= rss_hard_limit)
+    VMSTAT_ADD(t, evictions, evict(t->rss - rss_hard_limit + 1, t));
+  while(!(kpage = palloc_get_page(pflags))){
+    if(flags & FRAME_NOEVICT)
+      return 0;
+    if((n = evict(PAGEOUT_BATCH, 0))){
+      VMSTAT_ADD(t, evictions, n);
+      tries = 0;
+      continue;
+    }
+    //every frame is pinned, shared or on its way to swap
+    if(++tries > FRAME_ALLOC_TRIES){
+      alloc_fail_cnt++;
+      return 0;
+    }
+    thread_yield();
+  }
+  return kpage;
+}
+
+/* Registers KPAGE as the frame holding SPTE.  The frame stays
+   pinned until frame_unpin(). */
+static void frame_insert(void *kpage, struct spt_entry *spte){
+  struct frame *f = malloc(sizeof(struct frame));
+  if(!f)
+    PANIC("frame_insert: out of memory");
+  f->kpage = kpage;
+  f->inode = 0;
+  f->pinned = 1;
+  list_init(&f->sptes);
+
+  lock_acquire(&frame_lock);
+  list_push_back(&f->sptes, &spte->f_elem);
+  spte->frame = f;
+  spte->pfn = kpage;
+  list_push_back(&frame_list, &f->elem);
+  rss_charge(spte);
+  alloc_cnt++;
+  lock_release(&frame_lock);
+}
+
+/* Allocates a frame for SPTE, evicting other frames as needed,
+   and returns its kernel address.  The frame is zeroed if FLAGS
+   has FRAME_ZERO.  It is pinned until the caller has filled and
+   mapped it and calls frame_unpin(); on failure the caller
+   releases it with frame_remove().  Returns a null pointer if
+   no frame can be had. */
+void *frame_alloc(struct spt_entry *spte, enum frame_flags flags){
+  void *kpage = frame_get_page(spte->t, flags);
+  if(kpage)
+    frame_insert(kpage, spte);
+  return kpage;
+}
+
+/* Makes SPTE's frame a candidate for eviction. */
+void frame_unpin(struct spt_entry *spte){
+  lock_acquire(&frame_lock);
+  if(spte->frame)
+    spte->frame->pinned = 0;
+  lock_release(&frame_lock);
+}
+
+/* Enters the frame of SPTE into the text cache as the first
+   READ_BYTES bytes of INODE at OFS, unless another process has
+   just cached the same page. */
+void frame_text_cache(struct spt_entry *spte, struct inode *inode, off_t ofs, size_t read_bytes){
+  struct frame *f;
+  bool cached = false;
+
+  //the cache's reference is taken first, and dropped if unused
+  text_hold(inode);
+  lock_acquire(&frame_lock);
+  f = spte->frame;
+  if(f){
+    f->inode = inode;
+    f->ofs = ofs;
+    f->read_bytes = read_bytes;
+    if(hash_insert(&text_cache, &f->t_elem))
+      f->inode = 0;
+    else
+      cached = true;
+  }
+  lock_release(&frame_lock);
+  if(!cached)
+    text_release(inode);
+}
+
+/* Makes SPTE map the cached frame holding the first READ_BYTES
+   bytes of INODE at OFS.  Returns false if it is not cached. */
+bool frame_text_lookup(struct inode *inode, off_t ofs, size_t read_bytes, struct spt_entry *spte){
+  struct frame key, *f = 0;
+  struct hash_elem *e;
+
+  key.inode = inode;
+  key.ofs = ofs;
+  key.read_bytes = read_bytes;
+  lock_acquire(&frame_lock);
+  e = hash_find(&text_cache, &key.t_elem);
+  if(e){
+    f = hash_entry(e, struct frame, t_elem);
+    list_push_back(&f->sptes, &spte->f_elem);
+    spte->frame = f;
+    spte->pfn = f->kpage;
+    rss_charge(spte);
+  }
+  lock_release(&frame_lock);
+  return f != 0;
+}
+
+/* Detaches SPTE from its frame, if any, after any eviction of
+   it still in flight has completed.  The frame is released once
+   no page maps it any more. */
+void frame_remove(struct spt_entry *spte){
+  struct inode *inode = 0;
+  struct frame *f;
+
+  lock_acquire(&frame_lock);
+  while(spte->evicting)
+    cond_wait(&evict_cond, &frame_lock);
+  f = spte->frame;
+  if(f){
+    list_remove(&spte->f_elem);
+    rss_uncharge(spte);
+    if(list_empty(&f->sptes)){
+      if(clock_hand == &f->elem)
+        clock_hand = list_next(clock_hand);
+      list_remove(&f->elem);
+      inode = text_uncache(f);
+      palloc_free_page(f->kpage);
+      free(f);
+    }
+    spte->frame = 0;
+    spte->pfn = 0;
+  }
+  lock_release(&frame_lock);
+  if(inode)
+    text_release(inode);
+}
+
+/* Waits until SPTE is not being written out to swap. */
+void frame_wait(struct spt_entry *spte){
+  lock_acquire(&frame_lock);
+  while(spte->evicting)
+    cond_wait(&evict_cond, &frame_lock);
+  lock_release(&frame_lock);
+}
+
+/* Makes DST, a page of a child process being forked, map the
+   frame of SRC.  A writable SRC becomes copy-on-write: its PTE
+   is made read-only and both pages are marked cow, so the first
+   write from either side faults into page_cow_fault().  Returns
+   false if SRC is not resident. */
+bool frame_share(struct spt_entry *src, struct spt_entry *dst){
+  struct frame *f;
+
+  lock_acquire(&frame_lock);
+  while(src->evicting)
+    cond_wait(&evict_cond, &frame_lock);
+  f = src->frame;
+  if(f){
+    if(src->writable && !src->cow){
+      src->cow = 1;
+      pagedir_set_writable(src->t->pagedir, src->vpn, false);
+    }
+    dst->cow = src->cow;
+    dst->frame = f;
+    dst->pfn = f->kpage;
+    list_push_back(&f->sptes, &dst->f_elem);
+    rss_charge(dst);
+  }
+  lock_release(&frame_lock);
+  return f != 0;
+}
+
+/* Returns true if SPTE's frame is mapped by other pages too. */
+static bool frame_shared(struct spt_entry *spte){
+  return spte->frame && list_size(&spte->frame->sptes) > 1;
+}
+
+/* Gives SPTE a private copy of the frame it shares with other
+   pages and stores the copy, pinned as by frame_alloc(), in
+   *KPAGE.  Stores a null pointer if SPTE is the frame's only
+   mapper or is no longer resident; the caller may then write to
+   the frame in place.  Returns false, leaving SPTE shared, if
+   no frame can be had for the copy. */
+bool frame_unshare(struct spt_entry *spte, void **kpage_){
+  void *kpage;
+  bool shared;
+
+  *kpage_ = 0;
+  lock_acquire(&frame_lock);
+  while(spte->evicting)
+    cond_wait(&evict_cond, &frame_lock);
+  shared = frame_shared(spte);
+  lock_release(&frame_lock);
+  if(!shared)
+    return true;
+  if(!(kpage = frame_get_page(spte->t, 0))){
+    //decided under frame_lock, as the others may have gone by now
+    lock_acquire(&frame_lock);
+    shared = frame_shared(spte);
+    lock_release(&frame_lock);
+    return !shared;
+  }
+
+  //the other mappers may have gone while we allocated
+  lock_acquire(&frame_lock);
+  shared = frame_shared(spte);
+  if(shared){
+    memcpy(kpage, spte->frame->kpage, PGSIZE);
+    list_remove(&spte->f_elem);
+    rss_uncharge(spte);
+    spte->frame = 0;
+    spte->pfn = 0;
+  }
+  lock_release(&frame_lock);
+  if(!shared){
+    palloc_free_page(kpage);
+    return true;
+  }
+  frame_insert(kpage, spte);
+  *kpage_ = kpage;
+  return true;
+}
+
+/* Returns the page mapping F that is not shared.  Shared frames
+   are never evicted, so this is the only one. */
+static struct spt_entry *frame_owner(struct frame *f){
+  return list_entry(list_front(&f->sptes), struct spt_entry, f_elem);
+}
+
+/* Advances the clock hand, wrapping around the frame table.
+   Each wrap ends a sweep and updates the working set estimates. */
+static struct frame *clock_next(void){
+  if(clock_hand == list_end(&frame_list)){
+    enum intr_level old_level = intr_disable();
+    thread_foreach(ws_update, 0);
+    intr_set_level(old_level);
+    clock_hand = list_begin(&frame_list);
+  }
+  struct frame *f = list_entry(clock_hand, struct frame, elem);
+  clock_hand = list_next(clock_hand);
+  return f;
+}
+
+/* Orders victims by owner and then by virtual address, so that
+   neighbouring pages of one process land in neighbouring slots. */
+static int victim_cmp(const void *a_, const void *b_){
+  const struct spt_entry *a = frame_owner(*(struct frame * const *) a_);
+  const struct spt_entry *b = frame_owner(*(struct frame * const *) b_);
+  if(a->t != b->t)
+    return a->t < b->t ? -1 : 1;
+  if(a->vpn != b->vpn)
+    return a->vpn < b->vpn ? -1 : 1;
+  return 0;
+}
+
+/* Evicts up to CNT frames to swap and returns the number of
+   frames freed. */
+size_t frame_evict(size_t cnt){
+  return evict(cnt, 0);
+}
+
+/* Evicts up to CNT frames, only of thread ONLY if it is nonnull.
+   Victims are picked and unmapped under frame_lock, then written
+   out together without holding it, so faults on other pages are
+   not held up by the disk writes.  Frames of processes above
+   their soft limit and working set are taken first, then those
+   of processes above their soft limit, and only then anyone's. */
+static size_t evict(size_t cnt, struct thread *only){
+  struct frame *victim[PAGEOUT_BATCH];
+  struct inode *inode[PAGEOUT_BATCH];
+  void *kpage[PAGEOUT_BATCH];
+  uint32_t idx[PAGEOUT_BATCH];
+  size_t n = 0, i, scan;
+  int tier;
+
+  if(cnt > PAGEOUT_BATCH)
+    cnt = PAGEOUT_BATCH;
+
+  lock_acquire(&frame_lock);
+  for(tier = only ? 2 : 0; tier <= 2 && n < cnt; tier++){
+    /* In the last tier, two sweeps are enough to clear every
+       accessed bit once. */
+    scan = (tier == 2 ? 2 : 1) * list_size(&frame_list);
+    while(n < cnt && scan-- > 0 && !list_empty(&frame_list)){
+      struct frame *f = clock_next();
+      struct spt_entry *spte;
+      struct thread *t;
+      uint32_t *pd;
+
+      //shared frames stay until the processes sharing them diverge
+      if(list_size(&f->sptes) > 1)
+        continue;
+      spte = frame_owner(f);
+      t = spte->t;
+      pd = t->pagedir;
+      if(f->pinned || (only && t != only))
+        continue;
+      if(tier < 2 && !rss_over(t, tier == 1))
+        continue;
+      if(pagedir_is_accessed(pd, spte->vpn)){
+        pagedir_set_accessed(pd, spte->vpn, false);
+        t->ws_ref++;
+        continue;
+      }
+      if(clock_hand == &f->elem)
+        clock_hand = list_next(clock_hand);
+      list_remove(&f->elem);
+      pagedir_clear_page(pd, spte->vpn);
+      spte->evicting = 1;
+      //evicted text goes to swap like any other page
+      inode[n] = text_uncache(f);
+      victim[n++] = f;
+    }
+  }
+  lock_release(&frame_lock);
+
+  if(n == 0)
+    return 0;
+  qsort(victim, n, sizeof *victim, victim_cmp);
+  for(i = 0; i < n; i++)
+    kpage[i] = victim[i]->kpage;
+  swap_out_batch(kpage, idx, n);
+
+  lock_acquire(&frame_lock);
+  for(i = 0; i < n; i++){
+    struct spt_entry *spte = frame_owner(victim[i]);
+    rss_uncharge(spte);
+    VMSTAT_ADD(spte->t, swap_outs, 1);
+    spte->swap_idx = idx[i];
+    spte->pfn = 0;
+    spte->frame = 0;
+    spte->evicting = 0;
+    palloc_free_page(victim[i]->kpage);
+    free(victim[i]);
+  }
+  evict_cnt += n;
+  cond_broadcast(&evict_cond, &frame_lock);
+  lock_release(&frame_lock);
+  for(i = 0; i < n; i++)
+    if(inode[i])
+      text_release(inode[i]);
+  return n;
+}
+
+/* Fills ST with the counters of T, or of the whole system if T
+   is a null pointer, and the current use of frames and swap. */
+void frame_get_stats(struct thread *t, struct vmstat *st){
+  struct list_elem *e;
+  enum intr_level old_level = intr_disable();
+
+  if(!t)
+    *st = vm_stats;
+  else if(t->stats)
+    *st = t->stats->vm;
+  else
+    memset(st, 0, sizeof *st);
+  intr_set_level(old_level);
+  st->frames = st->pinned_frames = 0;
+  lock_acquire(&frame_lock);
+  for(e = list_begin(&frame_list); e != list_end(&frame_list); e = list_next(e)){
+    st->frames++;
+    if(list_entry(e, struct frame, elem)->pinned)
+      st->pinned_frames++;
+  }
+  lock_release(&frame_lock);
+  swap_get_stats(st);
+}
+
+/* Prints frame allocation and VM statistics.  Takes no locks, as
+   it may run from a kernel panic. */
+void frame_print_stats(void){
+  struct vmstat st = vm_stats;
+
+  swap_get_stats(&st);
+  printf("Frames: %lld allocated, %lld evicted, %lld allocations failed\n",
+         alloc_cnt, evict_cnt, alloc_fail_cnt);
+  printf("Faults: %lld minor, %lld major, %lld stack growth\n",
+         st.minor_faults, st.major_faults, st.stack_faults);
+  printf("Swap: %lld pages in, %lld pages out, %d of %d slots used, "
+         "%d pages compressed\n", st.swap_ins, st.swap_outs,
+         st.swap_slots_used, st.swap_slots, st.zip_pages);
+}
+
+/* Starts the page-out daemon. */
+void pageout_start(void){
+  thread_create("pageout", PRI_DEFAULT, pageout_daemon, 0);
+}
+
+/* Sleeps until the user pool falls below its low watermark,
+   then evicts frames in batches until the high watermark is
+   reached again or nothing else can be evicted. */
+static void pageout_daemon(void *aux UNUSED){
+  for(;;){
+    palloc_wait_low_water();
+    while(palloc_below_high_water() && frame_evict(PAGEOUT_BATCH))
+      continue;
+  }
+}
@@ -0,0 +1,70 @@
+#ifndef VM_FRAME_H
+# define VM_FRAME_H
+
+#include <list.h>
+#include <hash.h>
+#include "filesys/off_t.h"
+#include "threads/interrupt.h"
+#include "vm/page.h"
+#include <vmstat.h>
+
+/* Number of frames the page-out daemon evicts per batch. */
+#define PAGEOUT_BATCH 16
+
+/* Flags for frame_alloc(). */
+enum frame_flags
+  {
+    FRAME_ZERO = 001,           /* Zero the frame. */
+    FRAME_NOEVICT = 002         /* Fail rather than evict. */
+  };
+
+extern size_t rss_soft_limit;
+extern size_t rss_hard_limit;
+
+/* VM counters of the whole system.  Each thread keeps its own in
+   struct thread; VMSTAT_ADD adds N to counter FIELD of both.  The
+   page fault handler, the page-out daemon and evicting threads
+   all update them, so they are updated with interrupts off; N is
+   evaluated before that. */
+extern struct vmstat vm_stats;
+#define VMSTAT_ADD(T, FIELD, N) do{                     \
+    long long n_ = (N);                                 \
+    enum intr_level old_level_ = intr_disable();        \
+    if((T)->stats)                                      \
+      (T)->stats->vm.FIELD += n_;                       \
+    vm_stats.FIELD += n_;                               \
+    intr_set_level(old_level_);                         \
+  }while(0)
+
+/* A user frame.  SPTES lists every page mapping it: more than
+   one after fork() until each process writes to its copy. */
+struct frame{
+  void *kpage;
+  struct list sptes;
+  bool pinned;                  /* Being filled, not yet mapped. */
+
+  /* Set while the frame is in the text cache, holding the first
+     READ_BYTES bytes of INODE at OFS. */
+  struct inode *inode;
+  off_t ofs;
+  size_t read_bytes;
+  struct hash_elem t_elem;
+
+  struct list_elem elem;
+};
+
+void frame_init(void);
+void *frame_alloc(struct spt_entry *spte, enum frame_flags flags);
+void frame_unpin(struct spt_entry *spte);
+void frame_text_cache(struct spt_entry *spte, struct inode *inode, off_t ofs, size_t read_bytes);
+bool frame_text_lookup(struct inode *inode, off_t ofs, size_t read_bytes, struct spt_entry *spte);
+void frame_remove(struct spt_entry *spte);
+void frame_wait(struct spt_entry *spte);
+bool frame_share(struct spt_entry *src, struct spt_entry *dst);
+bool frame_unshare(struct spt_entry *spte, void **kpage);
+size_t frame_evict(size_t cnt);
+void frame_get_stats(struct thread *t, struct vmstat *st);
+void frame_print_stats(void);
+void pageout_start(void);
+
+#endif
@@ -5,70 +5,343 @@
 #include "filesys/file.h"
 #include "userprog/process.h"
 #include "threads/vaddr.h"
+#include "threads/pte.h"
 #include "vm/swap.h"
+#include "vm/frame.h"
 #include "userprog/pagedir.h"
+#include "threads/slab.h"
 #include <stdlib.h>
 
-static unsigned spt_hash_func(const struct hash_elem *he, void *aux UNUSED){
-  return hash_int((int)hash_entry(he, struct spt_entry, h_elem)->vpn);
+/* Swap read-around: up to READAROUND_PAGES pages on each side of
+   a faulting page are swapped in with it, as long as their slots
+   are within READAROUND_SLOTS of the faulting page's slot. */
+#define READAROUND_PAGES 4
+#define READAROUND_SLOTS 16
+
+/* Stack growth maps the faulting page, any pages skipped between
+   it and the bottom of the stack, and up to STACK_GROW_PAGES - 1
+   pages below it, so a large stack frame costs one fault. */
+#define STACK_GROW_PAGES 4
+
+/* Kernel page of zeros shared read-only by every untouched
+   stack and bss page. */
+static void *zero_page;
+
+/* Cache of struct spt_entry. */
+static struct kmem_cache *spte_cache;
+
+void page_init(void){
+  zero_page = palloc_get_page(PAL_ASSERT | PAL_ZERO);
+  spte_cache = kmem_cache_create("spt_entry", sizeof(struct spt_entry), 0);
 }
 
-static bool spt_less_func(const struct hash_elem *he1, const struct hash_elem *he2, void *aux UNUSED){
-  return hash_entry(he1, struct spt_entry, h_elem)->vpn < hash_entry(he2, struct spt_entry, h_elem)->vpn;
+/* Returns a new, uninitialized spt_entry, or a null pointer if
+   memory is not available. */
+struct spt_entry *spte_alloc(void){
+  return kmem_cache_alloc(spte_cache);
 }
 
-void spt_init(struct hash *spt){
-  hash_init(spt, spt_hash_func, spt_less_func, 0);
+/* Frees SPTE, which was never entered in an spt. */
+void spte_release(struct spt_entry *spte){
+  kmem_cache_free(spte_cache, spte);
 }
 
-bool insert_spte(struct hash *spt, struct spt_entry *spte){
-  return !hash_insert(spt, &spte->h_elem);
+void spt_init(struct spt *spt){
+  spt->dir = 0;
 }
 
-bool delete_spte(struct hash *spt, struct spt_entry *spte){
-  return hash_delete(spt, &spte->h_elem);
+/* Returns the slot for UPAGE in SPT, allocating the directory
+   and leaf on the way if CREATE is true.  Returns a null pointer
+   if they do not exist or cannot be allocated. */
+static struct spt_entry **spt_slot(struct spt *spt, const void *upage, bool create){
+  struct spt_entry ***leaf;
+
+  if(!spt->dir){
+	if(!create || !(spt->dir = palloc_get_page(PAL_ZERO)))
+	  return 0;
+  }
+  leaf = &spt->dir[pd_no(upage)];
+  if(!*leaf){
+	if(!create || !(*leaf = palloc_get_page(PAL_ZERO)))
+	  return 0;
+  }
+  return &(*leaf)[pt_no(upage)];
 }
 
-struct spt_entry *find_spt_entry(void *va){
-  struct spt_entry spte;
-  struct hash_elem *he;
+bool insert_spte(struct spt *spt, struct spt_entry *spte){
+  struct spt_entry **slot = spt_slot(spt, spte->vpn, true);
+  if(!slot || *slot)
+	return false;
+  *slot = spte;
+  return true;
+}
 
-  spte.vpn = pg_round_down(va);
-  if(!(he = hash_find(&thread_current()->spt, &spte.h_elem))){
+bool delete_spte(struct spt *spt, struct spt_entry *spte){
+  struct spt_entry **slot = spt_slot(spt, spte->vpn, false);
+  if(!slot || *slot != spte)
 	return false;
-  }
-  return hash_entry(he, struct spt_entry, h_elem);
+  *slot = 0;
+  return true;
+}
+
+struct spt_entry *find_spt_entry(void *va){
+  struct spt_entry **slot = spt_slot(&thread_current()->spt, va, false);
+  return slot ? *slot : 0;
 }
 
-void spte_free(struct hash_elem *he, void *aux UNUSED){
-  struct spt_entry *spte = hash_entry(he, struct spt_entry, h_elem);
+void spte_free(struct spt_entry *spte){
   struct thread *t = thread_current();
   if(spte){
-	if(spte->swap_idx != -1)
-	  bitmap_flip(swap_check, spte->swap_idx);
-	palloc_free_page(pagedir_get_page(t->pagedir, spte->vpn));
 	pagedir_clear_page(t->pagedir, spte->vpn);
-	free(spte);
+	frame_remove(spte);
+	if(spte->swap_idx != -1)
+	  clear_block(spte->swap_idx);
+	kmem_cache_free(spte_cache, spte);
+  }
+}
+
+/* Frees every entry of SPT, sweeping the leaves in address
+   order, and then the leaves and directory themselves. */
+void spt_destroy(struct spt *spt){
+  if(!spt->dir)
+	return;
+  for(size_t i = 0; i < PGSIZE / sizeof *spt->dir; i++){
+	struct spt_entry **leaf = spt->dir[i];
+	if(!leaf)
+	  continue;
+	for(size_t j = 0; j < PGSIZE / sizeof *leaf; j++)
+	  spte_free(leaf[j]);
+	palloc_free_page(leaf);
+  }
+  palloc_free_page(spt->dir);
+  spt->dir = 0;
+}
+
+/* Brings in the swapped-out neighbours of SPTE, which has just
+   been swapped in by a fault, while free frames are available.
+   Stops in each direction at the first page that is resident,
+   unmapped or stored far away in swap. */
+void page_readaround(struct spt_entry *spte, int32_t slot){
+  for(int dir = -1; dir <= 1; dir += 2){
+	for(int k = 1; k <= READAROUND_PAGES; k++){
+	  void *vpn = spte->vpn + dir * k * PGSIZE;
+	  struct spt_entry *n;
+	  void *kpage;
+
+	  if(vpn < (void *) PGSIZE || !is_user_vaddr(vpn))
+		break;
+	  if(!(n = find_spt_entry(vpn)))
+		break;
+	  frame_wait(n);
+	  if(n->swap_idx == -1)
+		break;
+	  if(n->swap_idx - slot > READAROUND_SLOTS || slot - n->swap_idx > READAROUND_SLOTS)
+		break;
+	  //only use frames that are free anyway
+	  if(palloc_below_high_water() || !(kpage = frame_alloc(n, FRAME_NOEVICT)))
+		return;
+	  swap_in(vpn, kpage);
+	  if(!install_page(vpn, kpage, n->writable)){
+		frame_remove(n);
+		return;
+	  }
+	  frame_unpin(n);
+	}
+  }
+}
+
+/* Maps UPAGE of the current process to the shared zero page,
+   read-only, without giving it a frame.  A write to a WRITABLE
+   page faults into page_zero_fault(). */
+bool page_map_zero(void *upage, bool writable){
+  struct spt_entry *spte = spte_alloc();
+  if(!spte)
+	return false;
+  spte->vpn = pg_round_down(upage);
+  spte->pfn = 0;
+  spte->writable = writable;
+  spte->evicting = 0;
+  spte->zero = 1;
+  spte->cow = 0;
+  spte->swap_idx = -1;
+  spte->t = thread_current();
+  spte->frame = 0;
+
+  if(!install_page(spte->vpn, zero_page, false)){
+	spte_release(spte);
+	return false;
+  }
+  if(!insert_spte(&thread_current()->spt, spte)){
+	pagedir_clear_page(thread_current()->pagedir, spte->vpn);
+	spte_release(spte);
+	return false;
+  }
+  return true;
+}
+
+/* Replaces the zero page mapping of SPTE with a private zeroed
+   frame, on the first write to the page. */
+bool page_zero_fault(struct spt_entry *spte){
+  struct thread *t = thread_current();
+  void *kpage;
+
+  if(!(kpage = frame_alloc(spte, FRAME_ZERO)))
+	return false;
+  pagedir_clear_page(t->pagedir, spte->vpn);
+  if(!install_page(spte->vpn, kpage, spte->writable)){
+	frame_remove(spte);
+	return false;
   }
+  spte->zero = 0;
+  frame_unpin(spte);
+  return true;
 }
 
-void spt_destroy(struct hash *spt){
-  hash_destroy(spt, spte_free);
+/* Gives SPTE, a copy-on-write page, a private writable frame on
+   the first write to it.  If the other processes have already
+   dropped the frame it is simply made writable again. */
+bool page_cow_fault(struct spt_entry *spte){
+  struct thread *t = thread_current();
+  void *kpage;
+
+  //still shared: no frame could be had for the copy
+  if(!frame_unshare(spte, &kpage))
+	return false;
+  if(kpage){
+	pagedir_clear_page(t->pagedir, spte->vpn);
+	if(!install_page(spte->vpn, kpage, true)){
+	  frame_remove(spte);
+	  return false;
+	}
+	frame_unpin(spte);
+  }
+  else if(spte->frame)
+	pagedir_set_writable(t->pagedir, spte->vpn, true);
+  //if it was evicted meanwhile, it comes back writable
+  spte->cow = 0;
+  return true;
 }
 
-void page_evict(void){
-  struct hash_iterator i;
+/* Adds to the current process, a child being forked, a copy of
+   its parent's page P.  Resident pages are shared copy-on-write,
+   zero pages map the zero page, and swapped-out pages are read
+   back into private frames, since swap slots are never shared. */
+static bool spte_fork(struct spt_entry *p){
   struct thread *t = thread_current();
-  struct spt_entry *spte = 0;
-  hash_first(&i, &t->spt);
-  while(hash_next(&i)){
-    spte = hash_entry(hash_cur(&i), struct spt_entry, h_elem);
-	if(!spte->pinned && spte->swap_idx == -1){
-	  spte->swap_idx = swap_out(spte->pfn);
-	  pagedir_clear_page(t->pagedir, spte->vpn);
-	  palloc_free_page(spte->pfn);
-	  spte->pfn = 0;
-	  spte->t = 0;
-    }
+  struct spt_entry *spte = spte_alloc();
+  void *kpage;
+
+  if(!spte)
+	return false;
+  spte->vpn = p->vpn;
+  spte->pfn = 0;
+  spte->writable = p->writable;
+  spte->evicting = 0;
+  spte->zero = p->zero;
+  spte->cow = 0;
+  spte->swap_idx = -1;
+  spte->t = t;
+  spte->frame = 0;
+  //in the spt first, so that spt_destroy() undoes a partial fork
+  if(!insert_spte(&t->spt, spte)){
+	spte_release(spte);
+	return false;
+  }
+
+  if(spte->zero)
+	return install_page(spte->vpn, zero_page, false);
+  if(frame_share(p, spte))
+	return install_page(spte->vpn, spte->pfn, spte->writable && !spte->cow);
+  if(p->swap_idx == -1)
+	return false;
+  if(!(kpage = frame_alloc(spte, 0)))
+	return false;
+  swap_copy(p->swap_idx, kpage);
+  if(!install_page(spte->vpn, kpage, spte->writable))
+	return false;
+  frame_unpin(spte);
+  return true;
+}
+
+/* Fills the spt and page directory of the current process, a
+   child being forked, with a copy of those of PARENT, which is
+   blocked until the child is done. */
+bool spt_fork(struct thread *parent){
+  struct spt_entry ***dir = parent->spt.dir;
+
+  if(!dir)
+	return true;
+  for(size_t i = 0; i < PGSIZE / sizeof *dir; i++){
+	if(!dir[i])
+	  continue;
+	for(size_t j = 0; j < PGSIZE / sizeof *dir[i]; j++){
+	  if(dir[i][j] && !spte_fork(dir[i][j]))
+		return false;
+	}
+  }
+  return true;
+}
+
+/* Maps the zeroed stack page VPN of the current process, with a
+   frame if FRAME is true and to the zero page otherwise. */
+static bool stack_map(void *vpn, bool frame){
+  struct spt_entry *spte;
+  void *kpage;
+
+  if(!frame)
+	return page_map_zero(vpn, true);
+  if(!(spte = spte_alloc()))
+	return false;
+  spte->pfn = 0;
+  spte->vpn = vpn;
+  spte->writable = 1;
+  spte->evicting = 0;
+  spte->zero = 0;
+  spte->cow = 0;
+  spte->t = thread_current();
+  spte->swap_idx = -1;
+  spte->frame = 0;
+
+  if(!insert_spte(&thread_current()->spt, spte)){
+	spte_release(spte);
+	return false;
+  }
+  if(!(kpage = frame_alloc(spte, FRAME_ZERO)) || !install_page(vpn, kpage, true))
+	return false;
+  frame_unpin(spte);
+  return true;
+}
+
+/* Reserves the stack region of the current process and maps its
+   top page. */
+bool page_stack_init(void){
+  struct stack_region *s = &thread_current()->ustack;
+
+  s->bottom = PHYS_BASE - PGSIZE;
+  s->limit = PHYS_BASE - STACK_MAX + PGSIZE;
+  return stack_map(s->bottom, true);
+}
+
+/* Grows the stack of the current process down over FAULT_ADDR,
+   which the caller has found to be near the stack pointer.
+   The faulting page gets a frame if WRITE is true.  Pages mapped
+   ahead of use only get frames while memory is plentiful and see
+   the zero page otherwise.  Returns false if FAULT_ADDR is
+   outside the stack region, as in the guard page. */
+bool page_stack_grow(void *fault_addr, bool write){
+  struct stack_region *s = &thread_current()->ustack;
+  void *vpn = pg_round_down(fault_addr);
+  void *low, *p;
+
+  if(vpn < s->limit || vpn >= s->bottom)
+	return false;
+  low = vpn - s->limit > (STACK_GROW_PAGES - 1) * PGSIZE
+	? vpn - (STACK_GROW_PAGES - 1) * PGSIZE : s->limit;
+  for(p = s->bottom - PGSIZE; p >= low; p -= PGSIZE){
+	bool frame = p == vpn ? write : !palloc_below_high_water();
+	if(!stack_map(p, frame))
+	  return false;
+	s->bottom = p;
   }
+  return true;
 }
@@ -5,28 +5,59 @@
 #define VM_FILE 1
 #define VM_ANON 2
 
-#include <hash.h>
+#include <list.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 struct spt_entry{
   void *vpn;
   void *pfn;
 
   bool writable;
-  bool pinned;
+  bool evicting;
+  bool zero;
+  bool cow;
 
   int32_t swap_idx;
+  struct frame *frame;
+  struct list_elem f_elem;
 
-  struct hash_elem h_elem;
   struct thread *t;
 };
 
-void spt_init(struct hash *spt);
-bool insert_spte(struct hash *spt, struct spt_entry *spte);
-bool delete_spte(struct hash *spt, struct spt_entry *spte);
+/* Supplemental page table, shaped like the page directory: DIR
+   is a page of pointers to leaves, one per 4 MB of virtual
+   memory, and each leaf a page of spt_entry pointers, one per
+   page.  Both are allocated on first use. */
+struct spt{
+  struct spt_entry ***dir;
+};
+
+/* Stack region of a process.  STACK_MAX bytes below PHYS_BASE
+   are reserved for the stack; the lowest page of them is a guard
+   page that is never mapped.  Pages from BOTTOM up to PHYS_BASE
+   are mapped. */
+#define STACK_MAX (8 * 1024 * 1024)
+struct stack_region{
+  void *bottom;                 /* Lowest mapped page. */
+  void *limit;                  /* Lowest page that may be mapped. */
+};
+
+void spt_init(struct spt *spt);
+bool insert_spte(struct spt *spt, struct spt_entry *spte);
+bool delete_spte(struct spt *spt, struct spt_entry *spte);
 struct spt_entry *find_spt_entry(void *va);
-void spte_free(struct hash_elem *he, void *aux);
-void spt_destroy(struct hash *spt);
-void page_evict(void);
+struct spt_entry *spte_alloc(void);
+void spte_release(struct spt_entry *spte);
+void spte_free(struct spt_entry *spte);
+void spt_destroy(struct spt *spt);
+void page_readaround(struct spt_entry *spte, int32_t slot);
+void page_init(void);
+bool page_map_zero(void *upage, bool writable);
+bool page_zero_fault(struct spt_entry *spte);
+bool page_cow_fault(struct spt_entry *spte);
+bool spt_fork(struct thread *parent);
+bool page_stack_init(void);
+bool page_stack_grow(void *fault_addr, bool write);
 
 #endif
@@ -3,43 +3,181 @@
 #include "threads/vaddr.h"
 #include "threads/palloc.h"
 #include "threads/thread.h"
+#include "threads/trace.h"
+#include "vm/frame.h"
+#include <lz.h>
+#include <round.h>
+#include <string.h>
 
 static struct block *swap_disk;
 static struct lock s_lock;
 
+/**pj4****************************************************/
+/* Compressed swap.  Pages that compress to at most ZIP_MAX bytes
+   are kept in an arena of ZIP_PAGES kernel pages, cut into
+   ZIP_CHUNK byte chunks, and only go to the swap disk once the
+   arena is full.  A compressed page is named by SWAP_ZIP plus its
+   first chunk, which keeps it apart from the disk slots. */
+#define ZIP_PAGES 32
+#define ZIP_CHUNK 64
+#define ZIP_CHUNKS (ZIP_PAGES * PGSIZE / ZIP_CHUNK)
+#define ZIP_MAX (PGSIZE / 2)
+#define SWAP_ZIP 0x40000000
+
+static uint8_t *zip_arena;
+static struct bitmap *zip_map;           /* Chunks in use. */
+static uint16_t zip_len[ZIP_CHUNKS];     /* Size by first chunk. */
+static int zip_cnt;                      /* Pages in the arena. */
+
+//scratch space, used under s_lock
+static uint8_t zip_buf[ZIP_MAX];
+static uint8_t lz_work[LZ_WORK_SIZE];
+
+static bool zip_out(const void *kpage, uint32_t *idx);
+static void zip_in(uint32_t idx, void *kpage);
+static void zip_free(uint32_t idx);
+/*********************************************************/
+
 void swap_init(void){
   swap_disk = block_get_role(BLOCK_SWAP);
   swap_check = bitmap_create(block_size(swap_disk) / 8);
   bitmap_set_all(swap_check, 0);
   lock_init(&s_lock);
+
+  //run without the compressed tier if the memory is not there
+  zip_arena = palloc_get_multiple(0, ZIP_PAGES);
+  if(zip_arena && !(zip_map = bitmap_create(ZIP_CHUNKS))){
+	palloc_free_multiple(zip_arena, ZIP_PAGES);
+	zip_arena = 0;
+  }
 }
 
 uint32_t swap_out(void *pfn){
+  uint32_t idx;
+  swap_out_batch(&pfn, &idx, 1);
+  return idx;
+}
+
+/* Writes the CNT pages at KPAGES to swap under a single
+   acquisition of the swap lock and stores the slot of each page
+   in IDX.  Pages that compress well go to the compressed arena
+   while it has room.  The rest of the batch is given one run of
+   adjacent disk slots when the swap disk has one, so it can
+   later be read back together. */
+void swap_out_batch(void **kpages, uint32_t *idx, size_t cnt){
+  size_t disk = 0, k = 0;
+
   lock_acquire(&s_lock);
-  uint32_t idx = bitmap_scan(swap_check, 0, 1, 0);
-  for(int i = 0; i < 8; i++){
-	block_write(swap_disk, idx * 8 + i, pfn + i * BLOCK_SECTOR_SIZE);
+  for(size_t i = 0; i < cnt; i++){
+	if(!zip_out(kpages[i], &idx[i])){
+	  idx[i] = 0;
+	  disk++;
+	}
+  }
+  size_t run = disk ? bitmap_scan_and_flip(swap_check, 0, disk, 0) : BITMAP_ERROR;
+  for(size_t i = 0; i < cnt; i++){
+	if(idx[i] & SWAP_ZIP)
+	  continue;
+	if(run != BITMAP_ERROR)
+	  idx[i] = run + k++;
+	else
+	  idx[i] = bitmap_scan_and_flip(swap_check, 0, 1, 0);
+	if(idx[i] == BITMAP_ERROR)
+	  PANIC("swap_out_batch: swap is full");
+	for(int j = 0; j < 8; j++){
+	  block_write(swap_disk, idx[i] * 8 + j, kpages[i] + j * BLOCK_SECTOR_SIZE);
+	}
   }
-  bitmap_flip(swap_check, idx);
+  for(size_t i = 0; i < cnt; i++)
+	trace_event(TRACE_SWAP_OUT, idx[i], 0);
   lock_release(&s_lock);
-  return idx;
 }
 
 void swap_in(void *vpn, void *kpage){
   struct spt_entry *spte = find_spt_entry(vpn);
   lock_acquire(&s_lock);
-  for(int i = 0; i < 8; i++){
-	block_read(swap_disk, spte->swap_idx * 8 + i, kpage + i * BLOCK_SECTOR_SIZE);
+  trace_event(TRACE_SWAP_IN, spte->swap_idx, 0);
+  if(spte->swap_idx & SWAP_ZIP){
+	zip_in(spte->swap_idx, kpage);
+	zip_free(spte->swap_idx);
+  }
+  else{
+	for(int i = 0; i < 8; i++){
+	  block_read(swap_disk, spte->swap_idx * 8 + i, kpage + i * BLOCK_SECTOR_SIZE);
+	}
+	bitmap_flip(swap_check, spte->swap_idx);
   }
-  bitmap_flip(swap_check, spte->swap_idx);
   spte->swap_idx = -1;
+  spte->cow = 0;
   spte->pfn = pg_round_down(kpage);
   spte->t = thread_current();
+  VMSTAT_ADD(spte->t, swap_ins, 1);
+  lock_release(&s_lock);
+}
+
+/* Reads swap slot IDX into KPAGE, leaving the slot in use. */
+void swap_copy(int32_t idx, void *kpage){
+  lock_acquire(&s_lock);
+  trace_event(TRACE_SWAP_IN, idx, 0);
+  if(idx & SWAP_ZIP)
+	zip_in(idx, kpage);
+  else{
+	for(int i = 0; i < 8; i++){
+	  block_read(swap_disk, idx * 8 + i, kpage + i * BLOCK_SECTOR_SIZE);
+	}
+  }
   lock_release(&s_lock);
 }
 
 void clear_block(int idx){
   lock_acquire(&s_lock);
-  bitmap_flip(swap_check, idx);
+  if(idx & SWAP_ZIP)
+	zip_free(idx);
+  else
+	bitmap_flip(swap_check, idx);
   lock_release(&s_lock);
 }
+
+/* Fills in the swap fields of ST.  Reads without s_lock, so it
+   is safe to call while shutting down. */
+void swap_get_stats(struct vmstat *st){
+  st->swap_slots = bitmap_size(swap_check);
+  st->swap_slots_used = bitmap_count(swap_check, 0, st->swap_slots, true);
+  st->zip_pages = zip_cnt;
+}
+
+/**pj4****************************************************/
+/* Stores KPAGE compressed in the arena and its slot in IDX.
+   Returns false if the page does not compress to ZIP_MAX bytes
+   or the arena has no room for it. */
+static bool zip_out(const void *kpage, uint32_t *idx){
+  size_t len, chunk;
+
+  if(!zip_arena)
+	return false;
+  if(!(len = lz_compress(kpage, PGSIZE, zip_buf, ZIP_MAX, lz_work)))
+	return false;
+  chunk = bitmap_scan_and_flip(zip_map, 0, DIV_ROUND_UP(len, ZIP_CHUNK), 0);
+  if(chunk == BITMAP_ERROR)
+	return false;
+  memcpy(zip_arena + chunk * ZIP_CHUNK, zip_buf, len);
+  zip_len[chunk] = len;
+  zip_cnt++;
+  *idx = SWAP_ZIP | chunk;
+  return true;
+}
+
+/* Decompresses slot IDX into KPAGE, leaving the slot in use. */
+static void zip_in(uint32_t idx, void *kpage){
+  size_t chunk = idx & ~SWAP_ZIP;
+  if(lz_decompress(zip_arena + chunk * ZIP_CHUNK, zip_len[chunk], kpage, PGSIZE) != PGSIZE)
+	PANIC("swap: compressed page %zu is corrupt", chunk);
+}
+
+/* Gives the chunks of slot IDX back to the arena. */
+static void zip_free(uint32_t idx){
+  size_t chunk = idx & ~SWAP_ZIP;
+  bitmap_set_multiple(zip_map, chunk, DIV_ROUND_UP(zip_len[chunk], ZIP_CHUNK), false);
+  zip_cnt--;
+}
+/*********************************************************/
@@ -3,15 +3,20 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <bitmap.h>
 #include "devices/block.h"
 #include "threads/synch.h"
+#include <vmstat.h>
 
 struct bitmap *swap_check;
 
 void swap_init(void);
 uint32_t swap_out(void *pfn);
+void swap_out_batch(void **kpages, uint32_t *idx, size_t cnt);
 void swap_in(void *vpn, void *kpage);
+void swap_copy(int32_t idx, void *kpage);
 void clear_block(int idx);
+void swap_get_stats(struct vmstat *st);
 
 #endif